@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <gb15/gb15.h>
+
+/**
+ * Frames per second of real hardware, 4194304 Hz over 70224 clocks a frame
+ */
+#define HARDWARE_FPS 59.7275
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+
+static void vblank_callback(GB15State *state, void *userdata) {
+}
+
+/**
+ * Run a ROM headless and as fast as it goes. Build once with GB15_JIT and once without to compare
+ * translated code with the interpreter on the same ROM.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <rom> [frames]\n", argv[0]);
+        return 1;
+    }
+    u32 frames = argc > 2? (u32)strtoul(argv[2], NULL, 10) : 3600;
+
+    GB15Cartridge *cartridge = gb15_cartridge_open(argv[1]);
+    if (cartridge == NULL) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+    GB15State *state = calloc(1, sizeof(GB15State));
+    if (state == NULL || !gb15_boot(state, cartridge, GB15_BOOT_FAST)) {
+        fprintf(stderr, "Out of memory booting %s\n", argv[1]);
+        if (state != NULL) {
+            gb15_shutdown(state);
+            free(state);
+        }
+        gb15_cartridge_release(cartridge);
+        return 1;
+    }
+    gb15_cartridge_release(cartridge);
+
+    double start = now();
+    for (u32 i = 0; i < frames; i++) {
+        gb15_run(state, GB15_CYCLES_PER_FRAME, vblank_callback, NULL);
+    }
+    double elapsed = now() - start;
+
+#ifdef GB15_JIT
+    const char *mode = "jit";
+#else
+    const char *mode = "interpreter";
+#endif
+    printf("%s: %u frames in %.3fs, %.1f frames/s, %.1fx hardware speed\n",
+           mode, frames, elapsed, frames / elapsed, frames / elapsed / HARDWARE_FPS);
+
+    gb15_shutdown(state);
+    free(state);
+    return 0;
+}
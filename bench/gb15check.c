@@ -0,0 +1,288 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gb15/gb15.h>
+
+/**
+ * Frames every program runs for before its state is printed
+ */
+#define FRAMES 600
+
+#define ROM_SIZE 0x8000
+
+typedef struct Patch {
+    u16 address;
+    u32 size;
+    const u8 *bytes;
+
+} Patch;
+
+#define PATCH(address, ...) {address, sizeof((const u8[]){ __VA_ARGS__ }), (const u8[]){ __VA_ARGS__ }}
+
+/**
+ * A test program, laid into an otherwise empty 32KB ROM that starts at 0x0150
+ */
+typedef struct Program {
+    const char *name;
+    Patch patches[8];
+
+} Program;
+
+static const Program PROGRAMS[] = {
+        {"alu", {
+                PATCH(0x0150,
+                      0x31, 0xF0, 0xDF, // ld sp, DFF0
+                      0x21, 0x00, 0xC0, // ld hl, C000
+                      0x01, 0x34, 0x12, // ld bc, 1234
+                      0x11, 0x78, 0x56, // ld de, 5678
+                      0x78,             // loop: ld a, b
+                      0x83,             // add a, e
+                      0x27,             // daa
+                      0x89,             // adc a, c
+                      0xF5, 0xC1,       // push af, pop bc
+                      0x92,             // sub a, d
+                      0xDE, 0x37,       // sbc a, 37
+                      0xAD,             // xor l
+                      0x07,             // rlca
+                      0xB8,             // cp b
+                      0x1F,             // rra
+                      0x14,             // inc d
+                      0x1D,             // dec e
+                      0x22,             // ld (hl+), a
+                      0xCB, 0x37,       // swap a
+                      0xCB, 0x39,       // srl c
+                      0xCB, 0x10,       // rl b
+                      0xCB, 0x5F,       // bit 3, a
+                      0xF5, 0xC1,       // push af, pop bc
+                      0x3F,             // ccf
+                      0x8E,             // adc a, (hl)
+                      0xAA,             // xor d
+                      0x57,             // ld d, a
+                      0x34,             // inc (hl)
+                      0x7C,             // ld a, h
+                      0xFE, 0xE0,       // cp E0
+                      0x20, 0x03,       // jr nz, +3
+                      0x21, 0x00, 0xC0, // ld hl, C000
+                      0x18, 0xD7),      // jr loop
+        }},
+        {"smc", {
+                PATCH(0x0150,
+                      0x31, 0xF0, 0xDF, // ld sp, DFF0
+                      0x21, 0x00, 0xC8, // ld hl, C800
+                      0x11, 0x7B, 0x01, // ld de, routine
+                      0x0E, 0x04,       // ld c, 4
+                      0x1A,             // copy: ld a, (de)
+                      0x22,             // ld (hl+), a
+                      0x13,             // inc de
+                      0x0D,             // dec c
+                      0x20, 0xFA,       // jr nz, copy
+                      0x1C,             // loop: inc e
+                      0x7B,             // ld a, e
+                      0xE6, 0x1F,       // and 1F
+                      0x21, 0x00, 0xC9, // ld hl, C900
+                      0x20, 0x03,       // jr nz, +3
+                      0x21, 0x02, 0xC8, // ld hl, C802
+                      0x7B,             // ld a, e
+                      0xCD, 0x00, 0xC8, // call C800
+                      0xF0, 0x80,       // ldh a, (80)
+                      0x80,             // add a, b
+                      0xE0, 0x80,       // ldh (80), a
+                      0x30, 0x01,       // jr nc, +1
+                      0x0C,             // inc c
+                      0x18, 0xE6,       // jr loop
+                      // routine, copied to C800, that every 32nd call rewrites the op after its store
+                      0x77,             // ld (hl), a
+                      0x06, 0x00,       // ld b, 0
+                      0xC9),            // ret
+        }},
+        {"interrupts", {
+                PATCH(0x0008,
+                      0x13,             // inc de
+                      0xC9),            // ret
+                PATCH(0x0040,
+                      0xC3, 0x60, 0x00),// jp vblank
+                PATCH(0x0048,
+                      0xC3, 0x70, 0x00),// jp stat
+                PATCH(0x0050,
+                      0xF5,             // timer: push af
+                      0x78,             // ld a, b
+                      0xEA, 0x20, 0xC1, // ld (C120), a
+                      0xF1,             // pop af
+                      0xD9),            // reti
+                PATCH(0x0060,
+                      0xF5,             // vblank: push af
+                      0xFA, 0x00, 0xC1, // ld a, (C100)
+                      0x3C,             // inc a
+                      0xEA, 0x00, 0xC1, // ld (C100), a
+                      0xF1,             // pop af
+                      0xD9),            // reti
+                PATCH(0x0070,
+                      0xF5,             // stat: push af
+                      0xF0, 0x45,       // ldh a, (LYC)
+                      0xC6, 0x17,       // add a, 17
+                      0xFE, 0x90,       // cp 90
+                      0x38, 0x02,       // jr c, +2
+                      0xD6, 0x90,       // sub a, 90
+                      0xE0, 0x45,       // ldh (LYC), a
+                      0xF0, 0x80,       // ldh a, (80)
+                      0x3C,             // inc a
+                      0xE0, 0x80,       // ldh (80), a
+                      0xF1,             // pop af
+                      0xD9),            // reti
+                PATCH(0x0150,
+                      0x31, 0xF0, 0xDF, // ld sp, DFF0
+                      0x3E, 0x07,       // ld a, 07
+                      0xE0, 0xFF,       // ldh (IE), a
+                      0x3E, 0x40,       // ld a, 40
+                      0xE0, 0x41,       // ldh (STAT), a
+                      0xFB,             // ei
+                      0x11, 0x00, 0x00, // ld de, 0
+                      0xCF,             // loop: rst 08
+                      0xE8, 0xFE,       // add sp, -2
+                      0xE8, 0x02,       // add sp, 2
+                      0x08, 0x10, 0xC1, // ld (C110), sp
+                      0xF8, 0x05,       // ld hl, sp + 5
+                      0x19,             // add hl, de
+                      0x7D,             // ld a, l
+                      0xEA, 0x12, 0xC1, // ld (C112), a
+                      0x3E, 0x04,       // ld a, 04
+                      0xE0, 0x0F,       // ldh (IF), a
+                      0x04,             // inc b
+                      0x7A,             // ld a, d
+                      0xE6, 0x07,       // and 07
+                      0xC4, 0x80, 0x01, // call nz, countdown
+                      0x76,             // halt
+                      0x00,             // nop
+                      0x18, 0xE2),      // jr loop
+                PATCH(0x0180,
+                      0x0B,             // countdown: dec bc
+                      0x78,             // ld a, b
+                      0xB1,             // or c
+                      0xC0,             // ret nz
+                      0x01, 0x00, 0x01, // ld bc, 0100
+                      0xC9),            // ret
+        }},
+};
+
+static u32 hash_bytes(u32 hash, const u8 *bytes, uz size) {
+    for (uz i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * (u32)16777619;
+    }
+    return hash;
+}
+
+static u32 hash_memory(u32 hash, GB15Mmu *mmu, u16 from, u16 to) {
+    for (u32 address = from; address <= to; address++) {
+        u8 value = gb15_mmu_read(mmu, (u16)address);
+        hash = hash_bytes(hash, &value, 1);
+    }
+    return hash;
+}
+
+static void vblank_callback(GB15State *state, void *userdata) {
+}
+
+/**
+ * Run a ROM and print the state it ends in, on one line
+ */
+static bool check(const char *name, const char *path) {
+    GB15Cartridge *cartridge = gb15_cartridge_open(path);
+    if (cartridge == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    GB15State *state = calloc(1, sizeof(GB15State));
+    if (state == NULL || !gb15_boot(state, cartridge, GB15_BOOT_FAST)) {
+        fprintf(stderr, "Out of memory booting %s\n", path);
+        if (state != NULL) {
+            gb15_shutdown(state);
+            free(state);
+        }
+        gb15_cartridge_release(cartridge);
+        return false;
+    }
+    gb15_cartridge_release(cartridge);
+
+    for (u32 i = 0; i < FRAMES; i++) {
+        gb15_run(state, GB15_CYCLES_PER_FRAME, vblank_callback, NULL);
+    }
+
+    GB15Cpu *cpu = &state->cpu;
+    GB15Mmu *mmu = &state->mmu;
+    gb15_cpu_sync_flags(cpu);
+    u32 memory = 2166136261u;
+    memory = hash_memory(memory, mmu, 0x8000, 0x9FFF);
+    memory = hash_memory(memory, mmu, 0xC000, 0xDFFF);
+    memory = hash_memory(memory, mmu, 0xFE00, 0xFE9F);
+    memory = hash_memory(memory, mmu, 0xFF80, 0xFFFE);
+    memory = hash_bytes(memory, mmu->io, sizeof(mmu->io));
+    u32 lcd = hash_bytes(2166136261u, (const u8 *)state->gpu.lcd, sizeof(u32) * GB15_LCD_PIXELS);
+    printf("%s: pc=%.4X sp=%.4X af=%.4X bc=%.4X de=%.4X hl=%.4X ime=%d cycles=%llu memory=%.8X lcd=%.8X\n",
+           name, cpu->pc, cpu->sp, cpu->af, cpu->bc, cpu->de, cpu->hl, cpu->ime,
+           (unsigned long long)state->scheduler.cycles, memory, lcd);
+
+    gb15_shutdown(state);
+    free(state);
+    return true;
+}
+
+/**
+ * Lay a program into a ROM image with a valid header and write it to a temporary file
+ */
+static bool write_program(const Program *program, char *path) {
+    static u8 rom[ROM_SIZE];
+    memset(rom, 0, sizeof(rom));
+    const u8 entry[] = {0x00, 0xC3, 0x50, 0x01}; // nop, jp 0150
+    memcpy(rom + 0x0100, entry, sizeof(entry));
+    memcpy(rom + 0x0134, program->name, strlen(program->name));
+    u8 checksum = 0;
+    for (u32 i = 0x0134; i <= 0x014C; i++) {
+        checksum = (u8)(checksum - rom[i] - 1);
+    }
+    rom[0x014D] = checksum;
+    for (u32 i = 0; i < sizeof(program->patches) / sizeof(program->patches[0]); i++) {
+        const Patch *patch = program->patches + i;
+        if (patch->size == 0) {
+            continue;
+        }
+        memcpy(rom + patch->address, patch->bytes, patch->size);
+    }
+
+    strcpy(path, "/tmp/gb15checkXXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = write(fd, rom, sizeof(rom)) == (ssize_t)sizeof(rom);
+    close(fd);
+    if (!written) {
+        unlink(path);
+    }
+    return written;
+}
+
+/**
+ * Print the state each built-in program, then each ROM given, ends in. Build once with GB15_JIT and
+ * once without; both must print the same.
+ */
+int main(int argc, char **argv) {
+    bool ok = true;
+    for (u32 i = 0; i < sizeof(PROGRAMS) / sizeof(PROGRAMS[0]); i++) {
+        char path[32];
+        if (!write_program(PROGRAMS + i, path)) {
+            fprintf(stderr, "Cannot write %s\n", PROGRAMS[i].name);
+            ok = false;
+            continue;
+        }
+        ok &= check(PROGRAMS[i].name, path);
+        unlink(path);
+    }
+    for (int i = 1; i < argc; i++) {
+        ok &= check(argv[i], argv[i]);
+    }
+    return ok? 0 : 1;
+}
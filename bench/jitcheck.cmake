@@ -0,0 +1,16 @@
+# Run gb15check built with and without the JIT, on its built-in programs and ROMS, and fail unless
+# both end every run in the same state
+
+foreach(BUILD JIT INTERPRETER)
+    execute_process(COMMAND ${${BUILD}} ${ROMS}
+            RESULT_VARIABLE RESULT
+            OUTPUT_VARIABLE ${BUILD}_OUTPUT)
+    if (NOT RESULT EQUAL 0)
+        message(FATAL_ERROR "${${BUILD}} failed: ${RESULT}")
+    endif()
+endforeach()
+
+message("${JIT_OUTPUT}")
+if (NOT JIT_OUTPUT STREQUAL INTERPRETER_OUTPUT)
+    message(FATAL_ERROR "The JIT and the interpreter disagree, the interpreter ends in\n${INTERPRETER_OUTPUT}")
+endif()
@@ -1,10 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <SDL2/SDL.h>
 
 #include <gb15/gb15.h>
 
+/**
+ * Frames between writing the save back to disk, on top of whenever the game disables its RAM
+ */
+#define SAVE_FLUSH_FRAMES 300
+
 typedef struct RenderState {
     SDL_Renderer *renderer;
     SDL_Texture *texture;
@@ -17,7 +23,7 @@ void vblank_callback(GB15State *state, void *userdata) {
     void *pixels;
     int pitch;
     SDL_LockTexture(texture, NULL, &pixels, &pitch);
-    memcpy(pixels, state->gpu.lcd, sizeof(u32) * 23040);
+    memcpy(pixels, state->gpu.lcd, sizeof(u32) * GB15_LCD_PIXELS);
     SDL_UnlockTexture(texture);
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, texture, NULL, NULL);
@@ -25,6 +31,13 @@ void vblank_callback(GB15State *state, void *userdata) {
 }
 
 int main(int argc, char *argv[]) {
+    const char *path = argc > 1? argv[1] : "cpu_instrs/individual/01-special.gb";
+    GB15Cartridge *cartridge = gb15_cartridge_open(path);
+    if (cartridge == NULL) {
+        fprintf(stderr, "Could not load %s\n", path);
+        return 1;
+    }
+
     SDL_Init(SDL_INIT_VIDEO);
     SDL_Window *window = SDL_CreateWindow("GB15", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 160 * 2, 144 * 2, SDL_WINDOW_SHOWN);
     SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
@@ -34,41 +47,40 @@ int main(int argc, char *argv[]) {
     render_state.renderer = renderer;
     render_state.texture = texture;
 
-    FILE *file = fopen("cpu_instrs/individual/01-special.gb", "rb");
-    fseek(file, 0, SEEK_END);
-    uz size = (uz)ftell(file);
-    rewind(file);
-    u8 *rom = malloc(size);
-    fread(rom, 1, size, file);
-    fclose(file);
-
     GB15State *state = calloc(1, sizeof(GB15State));
-    gb15_boot(state);
+    if (state == NULL || !gb15_boot(state, cartridge, GB15_BOOT_BIOS)) {
+        fprintf(stderr, "Out of memory booting %s\n", path);
+        return 1;
+    }
+    gb15_cartridge_release(cartridge);
+
+    // The save sits next to the ROM, with the extension swapped
+    char save_path[4096];
+    snprintf(save_path, sizeof(save_path) - 4, "%s", path);
+    char *extension = strrchr(save_path, '.');
+    if (extension == NULL || strchr(extension, '/') != NULL) {
+        extension = save_path + strlen(save_path);
+    }
+    strcpy(extension, ".sav");
+    gb15_save_open(state, save_path);
 
-    u32 cycles = 0;
-//    u32 second_timer = SDL_GetTicks();
-    u32 input_timer = SDL_GetTicks();
-    while (true) {
-        gb15_tick(state, rom, vblank_callback, &render_state);
-        cycles++;
-        u32 current_time = SDL_GetTicks();
-//        if (current_time - second_timer >= 1000) {
-//            printf("cps: %d\n", cycles);
-//            cycles = 0;
-//            second_timer = current_time;
-//        }
-        if (current_time - input_timer > 17) {
-            SDL_Event event;
-            SDL_PollEvent(&event);
+    bool running = true;
+    u32 frames = 0;
+    while (running) {
+        gb15_run(state, GB15_CYCLES_PER_FRAME, vblank_callback, &render_state);
+        if (++frames % SAVE_FLUSH_FRAMES == 0) {
+            gb15_save_flush(state);
+        }
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
-                break;
+                running = false;
             }
-            input_timer = current_time;
         }
     }
 
+    gb15_shutdown(state);
     free(state);
-    free(rom);
 
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
@@ -3,6 +3,15 @@
 
 #include <gb15/types.h>
 
+struct GB15State;
+
 GB15_EXTERN const u8 GB15_BIOS[256];
 
+/**
+ * Leave a freshly booted state the way the boot ROM does when it hands over to the cartridge:
+ * documented post-boot registers and IO, the logo tiles and map in VRAM, the boot ROM unmapped and
+ * the CPU at 0x0100. The logo and header checksum checks are skipped.
+ */
+GB15_EXTERN void gb15_bios_skip(struct GB15State *state);
+
 #endif /* _GB15_BIOS_H_ */
\ No newline at end of file
@@ -0,0 +1,167 @@
+#ifndef _GB15_BLOCK_H_
+#define _GB15_BLOCK_H_
+
+#include <gb15/types.h>
+#include <gb15/mmu.h>
+
+/**
+ * Longest straight-line run of instructions decoded into one block
+ */
+#define GB15_BLOCK_MAX_OPS 32
+
+/**
+ * Number of direct-mapped cache slots. Must be a power of two.
+ */
+#define GB15_BLOCK_CACHE_SIZE 1024
+
+#ifdef GB15_JIT
+/**
+ * Executions of a cached block before it is translated to native code
+ */
+#define GB15_JIT_THRESHOLD 16
+
+/**
+ * Size of the executable buffer. Every translation is dropped when it fills up.
+ */
+#define GB15_JIT_CODE_SIZE (4 << 20)
+#endif
+
+struct GB15State;
+
+/**
+ * Native code for a block, produced by the JIT or by gb15rc. Runs ops from the current pc until one
+ * of them would make the interpreter leave the block, then returns.
+ */
+typedef void (*GB15NativeBlock)(struct GB15State *state);
+
+typedef struct GB15RecompiledEntry {
+    u16 pc;
+    GB15NativeBlock run;
+
+} GB15RecompiledEntry;
+
+/**
+ * Output of gb15rc, linked into the program that runs the ROM
+ */
+typedef struct GB15Recompiled {
+    /**
+     * Global checksum of the ROM the code was generated from
+     */
+    u16 checksum;
+
+    /**
+     * One entry per recompiled instruction, sorted by pc
+     */
+    const GB15RecompiledEntry *entries;
+    u32 count;
+
+} GB15Recompiled;
+
+typedef struct GB15BlockOp {
+    /**
+     * Opcode. CB-prefixed instructions are resolved to 0x100-0x1FF.
+     */
+    u16 index;
+
+    /**
+     * Immediate operand, zero-extended when it is a single byte
+     */
+    u16 imm;
+
+    /**
+     * Address of the opcode
+     */
+    u16 pc;
+
+    /**
+     * Address of the following instruction
+     */
+    u16 next;
+
+    /**
+     * Interpreter entry point: the index, or a superinstruction that also runs the ops after this one
+     */
+    u16 dispatch;
+
+} GB15BlockOp;
+
+typedef struct GB15Block {
+    /**
+     * Start address in the low 16 bits, bank of the memory it was decoded from above
+     */
+    u32 key;
+
+    /**
+     * Number of decoded ops. The slot is empty when zero.
+     */
+    u32 length;
+
+    /**
+     * Translated or recompiled code. The block is interpreted while NULL.
+     */
+    GB15NativeBlock native;
+
+#ifdef GB15_JIT
+    /**
+     * Times the interpreter has run the block
+     */
+    u32 hits;
+#endif
+
+    GB15BlockOp ops[GB15_BLOCK_MAX_OPS];
+
+} GB15Block;
+
+typedef struct GB15BlockCache {
+    /**
+     * GB15_BLOCK_CACHE_SIZE slots in a page-aligned mapping of their own
+     */
+    GB15Block *blocks;
+
+    /**
+     * Single instruction decoded from memory that is never cached (VRAM, cart RAM, OAM, IO)
+     */
+    GB15Block scratch;
+
+    /**
+     * Ahead-of-time recompiled code for the current ROM, if any
+     */
+    const GB15Recompiled *recompiled;
+
+#ifdef GB15_JIT
+    /**
+     * Executable buffer shared by every translated block. NULL when it could not be mapped.
+     */
+    u8 *code;
+    u32 code_used;
+#endif
+
+} GB15BlockCache;
+
+/**
+ * Empty every slot, mapping them first if they are not yet. Returns false when they cannot be.
+ */
+GB15_EXTERN bool gb15_block_cache_init(GB15BlockCache *cache);
+
+/**
+ * Unmap the slots and the JIT code buffer. The cache must be initialized again before blocks are
+ * looked up.
+ */
+GB15_EXTERN void gb15_block_cache_release(GB15BlockCache *cache);
+
+/**
+ * Slot a block with this key lives in. The caller checks the key and length to tell a hit from a miss.
+ */
+GB15_EXTERN GB15Block *gb15_block_cache_slot(GB15BlockCache *cache, u32 key);
+
+/**
+ * Recompiled code entered at pc, NULL when there is none
+ */
+GB15_EXTERN GB15NativeBlock gb15_block_cache_recompiled(GB15BlockCache *cache, u16 pc);
+
+/**
+ * Drop every block that overlaps a page written since the last flush
+ */
+GB15_EXTERN void gb15_block_cache_flush(GB15BlockCache *cache, GB15Mmu *mmu);
+
+#endif /* _GB15_BLOCK_H_ */
@@ -0,0 +1,106 @@
+#ifndef _GB15_CARTRIDGE_H_
+#define _GB15_CARTRIDGE_H_
+
+#include <gb15/types.h>
+
+typedef enum GB15Mbc {
+    GB15_MBC_NONE = 0,
+    GB15_MBC1,
+    GB15_MBC2,
+    GB15_MBC3,
+    GB15_MBC5,
+
+} GB15Mbc;
+
+/**
+ * 0x0143 flag set by games that use the Gameboy Color features. 0xC0 also marks ones that do not
+ * run on older models.
+ */
+#define GB15_CGB_SUPPORTED 0x80
+
+/**
+ * Everything the emulator needs from 0x0134-0x014F
+ */
+typedef struct GB15CartridgeHeader {
+    /**
+     * Upper case ASCII, NUL terminated. Carts for the Gameboy Color only leave room for 15
+     * characters.
+     */
+    char title[17];
+
+    /**
+     * 0x0147 cartridge type, and the mapper and extras it implies
+     */
+    u8 type;
+    GB15Mbc mbc;
+    bool battery;
+    bool rtc;
+
+    /**
+     * 0x0143 CGB flag
+     */
+    u8 cgb;
+
+    /**
+     * 16KB ROM banks and bytes of cart RAM. MBC2 has 512 half bytes built in, kept one to a byte.
+     */
+    u16 rom_banks;
+    u32 ram_size;
+
+    /**
+     * 8KB RAM banks. Always a power of two, or zero.
+     */
+    u8 ram_banks;
+
+    /**
+     * 0x014D checksum of 0x0134-0x014C, and the big endian 0x014E sum of the whole ROM. Hardware
+     * does not check the latter, but recompiled code is matched against it.
+     */
+    u8 header_checksum;
+    u16 global_checksum;
+
+} GB15CartridgeHeader;
+
+/**
+ * ROM image mapped read-only from a file. Any number of states may run it at once; each holds a
+ * reference and they all read the same pages.
+ */
+typedef struct GB15Cartridge {
+    /**
+     * The whole file. Holds at least every bank the header declares.
+     */
+    const u8 *rom;
+    uz size;
+
+    GB15CartridgeHeader header;
+
+    /**
+     * References held. The file is unmapped when the last is released.
+     */
+    u32 refs;
+
+} GB15Cartridge;
+
+/**
+ * Parse the header of a ROM image. Returns false when the image is too short to hold it or the banks
+ * it declares, or the header checksum is wrong.
+ */
+GB15_EXTERN bool gb15_cartridge_parse_header(GB15CartridgeHeader *header, const u8 *rom, uz size);
+
+/**
+ * Map a ROM file and check its header. Returns NULL when the file cannot be mapped, its header
+ * checksum is wrong or it is shorter than the header says. The caller owns the first reference.
+ */
+GB15_EXTERN GB15Cartridge *gb15_cartridge_open(const char *path);
+
+/**
+ * Take another reference. Safe from any thread.
+ */
+GB15_EXTERN GB15Cartridge *gb15_cartridge_retain(GB15Cartridge *cartridge);
+
+/**
+ * Drop a reference, unmapping the file with the last one. Safe from any thread.
+ */
+GB15_EXTERN void gb15_cartridge_release(GB15Cartridge *cartridge);
+
+#endif /* _GB15_CARTRIDGE_H_ */
@@ -13,6 +13,55 @@ typedef struct GB15LongRegister {
     };
 } GB15LongRegister;
 
+typedef enum GB15FlagsOp {
+    /**
+     * F holds the current flags
+     */
+    GB15_FLAGS_NONE = 0,
+
+    /**
+     * Z from result, H and C from the 9-bit sum (add, adc)
+     */
+    GB15_FLAGS_ADD,
+
+    /**
+     * Z from result, N set, H and C from the borrow (sub, sbc, cp)
+     */
+    GB15_FLAGS_SUB,
+
+    /**
+     * Z from result, H set, C clear (and)
+     */
+    GB15_FLAGS_AND,
+
+    /**
+     * Z from result, H and C clear (or, xor)
+     */
+    GB15_FLAGS_LOGIC,
+
+    /**
+     * Like add and sub by one, but C is the preserved carry
+     */
+    GB15_FLAGS_INC,
+    GB15_FLAGS_DEC,
+
+    /**
+     * Z from result, C is the bit shifted out (CB rotates and shifts, swap)
+     */
+    GB15_FLAGS_SHIFT,
+
+    /**
+     * As above with Z clear (rlca, rla, rrca, rra)
+     */
+    GB15_FLAGS_ROTATE_A,
+
+    /**
+     * Z from the tested bit, H set, C is the preserved carry
+     */
+    GB15_FLAGS_BIT,
+
+} GB15FlagsOp;
+
 typedef struct GB15Cpu {
     union {
         u16 pc;
@@ -88,6 +137,21 @@ typedef struct GB15Cpu {
      */
     u8 halt_flags;
 
+    /**
+     * Last flag-setting operation. Z/N/H/C in f are only valid while this is GB15_FLAGS_NONE,
+     * call gb15_cpu_sync_flags before reading them from outside the CPU.
+     */
+    u8 flags_op;
+    u8 flags_lhs;
+    u8 flags_rhs;
+    u8 flags_carry;
+    u16 flags_result;
+
 } GB15Cpu;
 
+/**
+ * Fold any pending lazily evaluated flags into f
+ */
+GB15_EXTERN void gb15_cpu_sync_flags(GB15Cpu *cpu);
+
 #endif /* _GB15_CPU_H_ */
\ No newline at end of file
@@ -2,19 +2,90 @@
 #define _GB15_H_
 
 #include <gb15/cpu.h>
+#include <gb15/scheduler.h>
 #include <gb15/mmu.h>
 #include <gb15/gpu.h>
+#include <gb15/block.h>
+#include <gb15/trace.h>
+#include <gb15/cartridge.h>
+#include <gb15/save.h>
 
+/**
+ * The scheduler counts machine cycles, the unit instructions, DIV and DMA are timed in. The LCD is
+ * timed in dots, 4 to the machine cycle, and converts at its boundary.
+ */
+#define GB15_DOTS_PER_CYCLE 4
+
+/**
+ * 154 lines of 456 dots
+ */
+#define GB15_CYCLES_PER_FRAME (154 * 456 / GB15_DOTS_PER_CYCLE)
+
+/**
+ * Ordered hottest first. RAM, the framebuffer and the block slots are mapped separately, which
+ * keeps the struct to a few KB.
+ */
 typedef struct GB15State {
 
     GB15Cpu cpu;
+    GB15Scheduler scheduler;
     GB15Mmu mmu;
     GB15Gpu gpu;
+    GB15BlockCache blocks;
+
+    /**
+     * Reference held on the cartridge being run, or NULL
+     */
+    GB15Cartridge *cartridge;
+
+    GB15Save save;
+
+#ifdef GB15_TRACE
+    GB15Trace trace;
+#endif
 
 } GB15State;
 
-GB15_EXTERN void gb15_boot(GB15State *state);
+typedef enum GB15BootMode {
+    /**
+     * Run the boot ROM, logo scroll and all
+     */
+    GB15_BOOT_BIOS = 0,
+
+    /**
+     * Start the cartridge at 0x0100 straight away, as the boot ROM would have left it
+     */
+    GB15_BOOT_FAST,
+
+} GB15BootMode;
+
+/**
+ * Power on with a cartridge, or none when it is NULL. The state takes its own reference and drops
+ * the one it held before, closing any save, so it must be zeroed before it is first booted. Returns
+ * false when the memory it needs cannot be mapped.
+ */
+GB15_EXTERN bool gb15_boot(GB15State *state, GB15Cartridge *cartridge, GB15BootMode mode);
+
+/**
+ * Close the save, unmap the memory mapped at boot and drop the reference on the cartridge. The
+ * state must be booted again before it runs.
+ */
+GB15_EXTERN void gb15_shutdown(GB15State *state);
+
+/**
+ * Run instructions up to the next scheduled event, then dispatch every event that is due
+ */
+GB15_EXTERN void gb15_tick(GB15State *state, GB15VBlankCallback vblank, void *userdata);
+
+/**
+ * Run for a budget of cycles, dispatching events as they come due. Returns once the budget is spent.
+ */
+GB15_EXTERN void gb15_run(GB15State *state, u32 cycles, GB15VBlankCallback vblank, void *userdata);
 
-GB15_EXTERN void gb15_tick(GB15State *state, u8 *rom, GB15VBlankCallback vblank, void *userdata);
+/**
+ * Run code recompiled by gb15rc wherever it covers the ROM, or stop doing so when code is NULL. Returns
+ * false when the code was generated from a different ROM or there is no cartridge.
+ */
+GB15_EXTERN bool gb15_use_recompiled(GB15State *state, const GB15Recompiled *code);
 
 #endif /* _GB15_H_ */
\ No newline at end of file
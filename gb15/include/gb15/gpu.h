@@ -2,14 +2,60 @@
 #define _GB15_GPU_H_
 
 #include <gb15/types.h>
+#include <gb15/scheduler.h>
+#include <gb15/mmu.h>
 
 struct GB15State;
 
+/**
+ * 160x144 pixels
+ */
+#define GB15_LCD_PIXELS 23040
+
+/**
+ * Tiles in 0x8000-0x97FF of each VRAM bank
+ */
+#define GB15_TILES 384
+
 typedef struct GB15Gpu {
-    bool stat_raised;
-    bool vblank_raised;
-    s32 clocks;
-    u32 lcd[23040];
+    /**
+     * LCD was on at the last line event
+     */
+    bool enabled;
+
+    /**
+     * Row of the window the next line shows. It only moves on lines the window is drawn on.
+     */
+    u8 window_line;
+
+    /**
+     * Framebuffer, in a page-aligned mapping of its own so it stays out of the hot state
+     */
+    u32 *lcd;
+
+    /**
+     * Every tile of every VRAM bank decoded to one palette index per pixel, 64 bytes per tile, in a
+     * page-aligned mapping. Rows are decoded again when the renderer next reaches them after a write.
+     */
+    u8 *tiles;
+
+    /**
+     * Rows of each tile written since they were last decoded, one bit per row
+     */
+    u8 tile_dirty[GB15_VRAM_BANKS * GB15_TILES];
+
+#ifndef GB15_DMG_ONLY
+    /**
+     * Gameboy Color palette RAM as written through BCPD and OCPD: 8 palettes of 4 little-endian
+     * RGB555 colors for the background, then 8 for objects
+     */
+    u8 palette_memory[2][64];
+
+    /**
+     * The same colors in the framebuffer's format, converted as they are written
+     */
+    u32 colors[2][32];
+#endif
 
 } GB15Gpu;
 
@@ -63,6 +109,7 @@ typedef enum GB15OamFlag {
     GB15_OAM_FLAG_FLIPH =     1 << 5,
     GB15_OAM_FLAG_DMG_COLOR = 1 << 4,
     GB15_OAM_FLAG_CHR =       1 << 3,
+    GB15_OAM_FLAG_CGB_COLOR = 0x07,
 
 } GB15OamFlag;
 
@@ -76,8 +123,40 @@ typedef struct GB15Oam {
 
 typedef void (*GB15VBlankCallback)(struct GB15State *state, void *userdata);
 
-void gb15_gpu_init(struct GB15State *state);
+/**
+ * Map the framebuffer and tile cache if they are not yet, clear the framebuffer, mark every tile for
+ * decoding and schedule the first line. Returns false when they cannot be mapped.
+ */
+bool gb15_gpu_init(struct GB15State *state);
+
+void gb15_gpu_release(struct GB15State *state);
+
+/**
+ * Mark the tile row behind a write to VRAM for decoding. Writes past the tile data are ignored.
+ */
+static inline void gb15_gpu_vram_written(GB15Gpu *gpu, u8 bank, u16 offset) {
+    if (offset < (u16)(GB15_TILES * 16)) {
+        gpu->tile_dirty[bank * GB15_TILES + (offset >> 4)] |= (u8)(1 << ((offset >> 1) & 0x07));
+    }
+}
+
+void gb15_gpu_event(struct GB15State *state, GB15EventType type, u64 when, GB15VBlankCallback vblank, void *userdata);
+
+/**
+ * IO write hooks for the LCD registers
+ */
+void gb15_gpu_write_lcdc(struct GB15State *state, u8 port, u8 value);
+void gb15_gpu_write_stat(struct GB15State *state, u8 port, u8 value);
+void gb15_gpu_write_lyc(struct GB15State *state, u8 port, u8 value);
 
-void gb15_gpu_tick(struct GB15State *state, u8 *rom, GB15VBlankCallback vblank, void *userdata);
+#ifndef GB15_DMG_ONLY
+/**
+ * IO hooks for the Gameboy Color palette registers. BCPS and OCPS pick a byte of palette RAM and
+ * optionally step past it on every write to BCPD or OCPD.
+ */
+void gb15_gpu_write_cps(struct GB15State *state, u8 port, u8 value);
+u8 gb15_gpu_read_cpd(struct GB15State *state, u8 port);
+void gb15_gpu_write_cpd(struct GB15State *state, u8 port, u8 value);
+#endif
 
 #endif /* _GB15_GPU_H_ */
\ No newline at end of file
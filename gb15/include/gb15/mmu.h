@@ -2,33 +2,83 @@
 #define _GB15_MEMMAP_H_
 
 #include <gb15/types.h>
+#include <gb15/cartridge.h>
+
+typedef enum GB15CodePage {
+    GB15_CODE_NONE = 0,
 
-typedef struct GB15Mmu {
     /**
-     * 0x8000-0x9FFF Video RAM (Two banks on Gameboy Color)
+     * Decoded blocks were built from this page
      */
-    u8 vram[2][8192]; // 8KB
+    GB15_CODE_CACHED,
 
     /**
-     * 0xA000-0xBFFF Optional cart extension RAM
+     * Page was written after its blocks were decoded. They are dropped on the next flush.
      */
-    u8 cram[8192]; // 8KB
+    GB15_CODE_WRITTEN,
+
+} GB15CodePage;
 
+/**
+ * Number of 8KB cartridge RAM banks addressable by any supported MBC
+ */
+#define GB15_CRAM_BANKS 16
+
+/**
+ * Number of 256 byte pages in those banks
+ */
+#define GB15_CRAM_PAGES (GB15_CRAM_BANKS * 32)
+
+/**
+ * MBC3 real time clock. The counter is derived from the host clock when it is read, never ticked.
+ */
+typedef struct GB15Rtc {
     /**
-     * 0xC000-0xCFFF Onboard Working RAM
+     * Host time, in seconds, at which the running counter was zero
      */
-    u8 wram[8192]; // 8KB
+    s64 base;
 
     /**
-     * 0xD000-0xDFFF Switchable RAM banks (on Gameboy Color)
+     * Counter value while halted
      */
-    u8 sram[8][8192]; // 8KB
+    s64 halted_at;
+
+    bool halted;
 
     /**
-     * 0xFE00-0xFE9F OAM Table
+     * Day counter overflowed past 511. Sticky until written.
      */
-    u8 oam[160];
+    bool carry;
+
+    /**
+     * Seconds, minutes, hours, day low and day high as of the last latch
+     */
+    u8 latched[5];
 
+    /**
+     * Last value written to 0x6000-0x7FFF. Writing 0x00 then 0x01 latches the counter.
+     */
+    u8 latch;
+
+} GB15Rtc;
+
+/**
+ * Banks of VRAM and of WRAM at 0xD000 a build can map
+ */
+#ifdef GB15_DMG_ONLY
+#define GB15_VRAM_BANKS 1
+#define GB15_WRAM_BANKS 1
+#else
+#define GB15_VRAM_BANKS 2
+#define GB15_WRAM_BANKS 8
+#endif
+
+/**
+ * Fields used by nearly every instruction come first, so that they share cache lines with the CPU
+ * registers and scheduler counters ahead of the MMU in GB15State. The RAM itself lives in a
+ * separate page-aligned mapping.
+ */
+typedef struct GB15Mmu {
     /**
      * 0xFF00-0xFF7F IO. Extended to 0xFFFF to hold IE Register
      */
@@ -40,10 +90,138 @@ typedef struct GB15Mmu {
     u8 hram[128];
 
     /**
-     * MBC Version
+     * Cycle count DIV was last reset at. DIV is derived from it when read.
+     */
+    u64 div_base;
+
+    /**
+     * OAM DMA is running. Every page is unmapped until it ends, and the slow path only lets the
+     * CPU reach IO and HRAM. The lock covers instruction fetches too: only HRAM blocks are cached
+     * meanwhile.
+     */
+    bool dma_active;
+
+#ifndef GB15_DMG_ONLY
+    /**
+     * Blocks of 16 bytes HBlank DMA has left to copy, one per HBlank. Zero when it is idle.
+     */
+    u8 hdma_blocks;
+
+    /**
+     * The cartridge supports Gameboy Color features, so VRAM and WRAM banking and HDMA are enabled
+     */
+    bool cgb;
+#endif
+
+    /**
+     * Some page holding cached code has been written, a ROM bank switched or OAM DMA started since
+     * the last flush. Running code leaves its block when this is set.
+     */
+    bool code_written;
+
+    /**
+     * MBC Version, the GB15Mbc of the cartridge header
      */
     u8 mbc_version;
 
+    /**
+     * Bank registers as last written: ROM bank, RAM bank (or RTC register on MBC3) and MBC1
+     * banking mode
+     */
+    u16 rom_select;
+    u8 ram_select;
+    u8 bank_mode;
+    bool ram_enabled;
+
+    /**
+     * Banks mapped at 0x0000, 0x4000 and 0xA000, derived from the registers
+     */
+    u16 rom_bank0;
+    u16 rom_bank;
+    u8 ram_bank;
+
+    /**
+     * Bank counts from the cartridge header. Always powers of two, or no RAM at all.
+     */
+    u16 rom_banks;
+    u8 ram_banks;
+
+    /**
+     * Writes to cart RAM are being tracked. Clean pages are mapped read-only, so the first write to
+     * each takes the slow path and marks it in cram_dirty.
+     */
+    bool cram_tracked;
+
+    /**
+     * The game disabled cart RAM while writes were tracked, which is when it expects a save to
+     * reach the battery
+     */
+    bool save_due;
+
+    /**
+     * 0x8000-0x9FFF Video RAM, banked by VBK. Bank 1 is only allocated on Gameboy Color; otherwise
+     * it points at bank 0.
+     */
+    u8 *vram[GB15_VRAM_BANKS];
+
+    /**
+     * 0xA000-0xBFFF Optional cart extension RAM, banked by the MBC. Points at cram_memory unless a
+     * save file is mapped in its place.
+     */
+    u8 *cram;
+
+    /**
+     * 0xC000-0xCFFF Onboard Working RAM
+     */
+    u8 *wram;
+
+    /**
+     * 0xD000-0xDFFF Switchable RAM banks, selected by SVBK. Banks 1-7 are only allocated on
+     * Gameboy Color; otherwise they point at bank 0.
+     */
+    u8 *sram[GB15_WRAM_BANKS];
+
+    /**
+     * Cartridge ROM the read pages of 0x0000-0x7FFF point into, or NULL when there is none
+     */
+    const u8 *rom;
+
+    /**
+     * Memory behind every 256 byte page as currently banked. NULL where accesses take the slow path:
+     * IO, OAM, unmapped memory, ROM writes, writes to VRAM tile data and RAM pages holding cached
+     * code.
+     */
+    const u8 *read_pages[256];
+    u8 *write_pages[256];
+
+    /**
+     * 0xFE00-0xFE9F OAM Table
+     */
+    u8 oam[160];
+
+    /**
+     * GB15CodePage state of every 256 byte page. Only WRAM and HRAM pages are tracked.
+     */
+    u8 code_pages[256];
+
+    /**
+     * Cart RAM pages written since the last flush while writes are tracked
+     */
+    bool cram_dirty[GB15_CRAM_PAGES];
+
+    GB15Rtc rtc;
+
+    /**
+     * Page-aligned mapping behind vram, wram, sram and cram_memory, sized for the cartridge
+     */
+    u8 *memory;
+    uz memory_size;
+
+    /**
+     * Cart RAM at the size the header declares, up to 128KB. NULL when there is none.
+     */
+    u8 *cram_memory;
+
 } GB15Mmu;
 
 typedef enum GB15IOPort {
@@ -54,10 +232,10 @@ typedef enum GB15IOPort {
     GB15_IO_JOYP =  0x00,
     GB15_IO_SB =    0x01,
     GB15_IO_SC =    0x02,
-    GB15_IO_DIV =   0x03,
-    GB15_IO_TIMA =  0x04,
-    GB15_IO_TMA =   0x05,
-    GB15_IO_TAC =   0x06,
+    GB15_IO_DIV =   0x04,
+    GB15_IO_TIMA =  0x05,
+    GB15_IO_TMA =   0x06,
+    GB15_IO_TAC =   0x07,
     GB15_IO_KEY1 =  0x4D,
     GB15_IO_RP =    0x56,
 
@@ -144,7 +322,80 @@ typedef enum GB15IOPort {
 
 } GB15IOPort;
 
-GB15_EXTERN u8 gb15_mmu_read(GB15Mmu *mmu, u8 *rom, u16 address);
-GB15_EXTERN u8 gb15_mmu_write(GB15Mmu *mmu, u16 address, u8 value);
+/**
+ * Reset the mapper for a cartridge, or none when it is NULL, and build the page tables. Must be
+ * called before any access. Cart RAM and the Gameboy Color banks are allocated as the header asks,
+ * replacing any from before. Returns false when they cannot be.
+ */
+GB15_EXTERN bool gb15_mmu_init(GB15Mmu *mmu, const GB15Cartridge *cartridge);
+
+/**
+ * Free the memory allocated by gb15_mmu_init. The MMU must be initialized again before any access.
+ */
+GB15_EXTERN void gb15_mmu_release(GB15Mmu *mmu);
+
+/**
+ * Back cart RAM with the given memory, tracking writes to it when tracked. Every page starts clean.
+ */
+GB15_EXTERN void gb15_mmu_map_cram(GB15Mmu *mmu, u8 *cram, bool tracked);
+
+/**
+ * End the bus lock of OAM DMA
+ */
+GB15_EXTERN void gb15_mmu_dma_end(GB15Mmu *mmu);
+
+#ifndef GB15_DMG_ONLY
+/**
+ * Copy the next block of a running HBlank DMA. Returns the cycles the CPU stalls for.
+ */
+GB15_EXTERN u32 gb15_mmu_hdma_hblank(GB15Mmu *mmu);
+#endif
+
+/**
+ * Mark a WRAM page as holding cached code, so that writes to it reach the slow path and flag it
+ */
+GB15_EXTERN void gb15_mmu_cache_code(GB15Mmu *mmu, u16 address);
+
+GB15_EXTERN u8 gb15_mmu_read_slow(GB15Mmu *mmu, u16 address);
+GB15_EXTERN u8 gb15_mmu_write_slow(GB15Mmu *mmu, u16 address, u8 value);
+
+static inline u8 gb15_mmu_read(GB15Mmu *mmu, u16 address) {
+    const u8 *page = mmu->read_pages[address >> 8];
+    if (page != NULL) {
+        return page[address & (u16)0xFF];
+    }
+    return gb15_mmu_read_slow(mmu, address);
+}
+
+static inline u8 gb15_mmu_write(GB15Mmu *mmu, u16 address, u8 value) {
+    u8 *page = mmu->write_pages[address >> 8];
+    if (page != NULL) {
+        return page[address & (u16)0xFF] = value;
+    }
+    return gb15_mmu_write_slow(mmu, address, value);
+}
+
+/**
+ * VRAM bank mapped at 0x8000 and WRAM bank mapped at 0xD000. Fixed at bank 0 with GB15_DMG_ONLY.
+ */
+static inline u8 gb15_mmu_vram_bank_index(GB15Mmu *mmu) {
+#ifdef GB15_DMG_ONLY
+    return 0;
+#else
+    return mmu->io[GB15_IO_VBK] & (u8)0x01;
+#endif
+}
+
+static inline u8 *gb15_mmu_vram_bank(GB15Mmu *mmu) {
+    return mmu->vram[gb15_mmu_vram_bank_index(mmu)];
+}
+
+static inline u8 *gb15_mmu_wram_bank(GB15Mmu *mmu) {
+#ifdef GB15_DMG_ONLY
+    return mmu->sram[0];
+#else
+    return mmu->sram[mmu->io[GB15_IO_SVBK] & 0x07];
+#endif
+}
 
 #endif /* _GB15_MEMMAP_H_ */
\ No newline at end of file
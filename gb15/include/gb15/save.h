@@ -0,0 +1,39 @@
+#ifndef _GB15_SAVE_H_
+#define _GB15_SAVE_H_
+
+#include <gb15/types.h>
+
+struct GB15State;
+
+/**
+ * Battery-backed cart RAM mapped shared from a save file. The game writes straight into the page
+ * cache; flushing only writes back the pages it touched.
+ */
+typedef struct GB15Save {
+    /**
+     * The mapping, or NULL when no save file is open
+     */
+    u8 *ram;
+    uz size;
+
+} GB15Save;
+
+/**
+ * Map a save file over the cart RAM, creating it when missing. Returns false when the cartridge
+ * has no battery-backed RAM or the file cannot be mapped. Any save already open is closed first.
+ */
+GB15_EXTERN bool gb15_save_open(struct GB15State *state, const char *path);
+
+/**
+ * Write the pages touched since the last flush back to the file and wait for them. Runs by itself
+ * when the game disables its RAM; call it at other points that suit, such as every few seconds.
+ * Returns false on a write error.
+ */
+GB15_EXTERN bool gb15_save_flush(struct GB15State *state);
+
+/**
+ * Flush and unmap the save. Cart RAM keeps its contents in the state.
+ */
+GB15_EXTERN void gb15_save_close(struct GB15State *state);
+
+#endif /* _GB15_SAVE_H_ */
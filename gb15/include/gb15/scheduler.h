@@ -0,0 +1,76 @@
+#ifndef _GB15_SCHEDULER_H_
+#define _GB15_SCHEDULER_H_
+
+#include <gb15/types.h>
+
+typedef enum GB15EventType {
+
+    /**
+     * GPU leaves OAM search and starts pixel transfer (mode 3)
+     */
+    GB15_EVENT_GPU_TRANSFER,
+
+    /**
+     * GPU finishes pixel transfer and enters HBlank (mode 0)
+     */
+    GB15_EVENT_GPU_HBLANK,
+
+    /**
+     * LY increments, GPU enters OAM search (mode 2) or VBlank (mode 1)
+     */
+    GB15_EVENT_GPU_LINE,
+
+    /**
+     * OAM DMA finishes and the CPU gets the bus back
+     */
+    GB15_EVENT_DMA_END,
+
+    /**
+     * Cycle budget of the current gb15_run call has been spent
+     */
+    GB15_EVENT_RUN_END,
+
+    GB15_EVENT_COUNT
+
+} GB15EventType;
+
+typedef struct GB15Event {
+    u64 when;
+    GB15EventType type;
+
+} GB15Event;
+
+typedef struct GB15Scheduler {
+    /**
+     * Machine cycles elapsed since boot
+     */
+    u64 cycles;
+
+    /**
+     * Timestamp of the earliest pending event
+     */
+    u64 next;
+
+    /**
+     * Min-heap of pending events ordered by timestamp. Each event type is pending at most once.
+     */
+    GB15Event events[GB15_EVENT_COUNT];
+    u32 count;
+
+} GB15Scheduler;
+
+GB15_EXTERN void gb15_scheduler_init(GB15Scheduler *scheduler);
+
+/**
+ * Schedule an event at an absolute timestamp, replacing any pending event of the same type
+ */
+GB15_EXTERN void gb15_scheduler_schedule(GB15Scheduler *scheduler, GB15EventType type, u64 when);
+
+GB15_EXTERN void gb15_scheduler_cancel(GB15Scheduler *scheduler, GB15EventType type);
+
+/**
+ * Remove the earliest event that is due at the current cycle count. Returns false when nothing is due.
+ */
+GB15_EXTERN bool gb15_scheduler_pop(GB15Scheduler *scheduler, GB15Event *event);
+
+#endif /* _GB15_SCHEDULER_H_ */
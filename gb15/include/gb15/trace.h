@@ -0,0 +1,96 @@
+#ifndef _GB15_TRACE_H_
+#define _GB15_TRACE_H_
+
+#include <stdio.h>
+
+#include <gb15/types.h>
+
+/**
+ * First bytes of a trace dump. It goes on with the record size and count as u32s, then the records
+ * oldest first.
+ */
+#define GB15_TRACE_MAGIC "GB15TRC1"
+
+/**
+ * Machine state as an instruction is entered. Dumps are written in host byte order.
+ */
+typedef struct GB15TraceRecord {
+    /**
+     * Cycles elapsed since boot
+     */
+    u64 cycles;
+
+    /**
+     * Address of the opcode
+     */
+    u16 pc;
+
+    /**
+     * Opcode. CB-prefixed instructions are 0x100-0x1FF.
+     */
+    u16 index;
+
+    /**
+     * Immediate operand, zero-extended when it is a single byte
+     */
+    u16 imm;
+
+    u16 af;
+    u16 bc;
+    u16 de;
+    u16 hl;
+    u16 sp;
+
+    /**
+     * Word at the top of the stack
+     */
+    u16 stack;
+
+    u8 lcdc;
+    u8 stat;
+    u8 ly;
+    u8 ie;
+    u8 iflag;
+    u8 reserved;
+
+} GB15TraceRecord;
+
+/**
+ * Ring of the most recently executed instructions. Only the emulation thread writes it; any thread
+ * may dump it without locking.
+ */
+typedef struct GB15Trace {
+    /**
+     * Caller-owned storage. Nothing is recorded while NULL.
+     */
+    GB15TraceRecord *records;
+
+    /**
+     * Capacity - 1. The capacity is a power of two.
+     */
+    u32 mask;
+
+    /**
+     * Records written since the trace started. The newest is at (head - 1) & mask.
+     */
+    u64 head;
+
+} GB15Trace;
+
+/**
+ * Start recording into records, or stop when records is NULL. Capacity must be a power of two.
+ */
+GB15_EXTERN void gb15_trace_start(GB15Trace *trace, GB15TraceRecord *records, u32 capacity);
+
+/**
+ * Copy out the newest records, oldest first. Records the writer overtook during the copy are
+ * dropped. Returns how many were copied.
+ */
+GB15_EXTERN u32 gb15_trace_read(const GB15Trace *trace, GB15TraceRecord *out, u32 capacity);
+
+/**
+ * Write the newest records to a file for gb15trace. Returns false on a write error.
+ */
+GB15_EXTERN bool gb15_trace_dump(const GB15Trace *trace, FILE *file);
+
+#endif /* _GB15_TRACE_H_ */
@@ -1,4 +1,7 @@
+#include <string.h>
+
 #include <gb15/bios.h>
+#include <gb15/gb15.h>
 
 /*
     LD SP,$fffe        ; $0000  Setup Stack
@@ -189,3 +192,118 @@ const u8 GB15_BIOS[256] = {
     0x21, 0x04, 0x01, 0x11, 0xA8, 0x00, 0x1A, 0x13, 0xBE, 0x20, 0xFE, 0x23, 0x7D, 0xFE, 0x34, 0x20,
     0xF5, 0x06, 0x19, 0x78, 0x86, 0x23, 0x05, 0x20, 0xFB, 0x86, 0x20, 0xFE, 0x3E, 0x01, 0xE0, 0x50
 };
+
+/**
+ * IO as the boot ROM leaves it. DIV and the BIOS register are set through their hooks.
+ */
+static const u8 POST_BOOT_IO[256] = {
+        [GB15_IO_JOYP] = 0xCF,
+        [GB15_IO_SC] =   0x7E,
+        [GB15_IO_TAC] =  0xF8,
+        [GB15_IO_IF] =   0xE1,
+        [GB15_IO_NR10] = 0x80,
+        [GB15_IO_NR11] = 0xBF,
+        [GB15_IO_NR12] = 0xF3,
+        [GB15_IO_NR13] = 0xFF,
+        [GB15_IO_NR14] = 0xBF,
+        [GB15_IO_NR21] = 0x3F,
+        [GB15_IO_NR23] = 0xFF,
+        [GB15_IO_NR24] = 0xBF,
+        [GB15_IO_NR30] = 0x7F,
+        [GB15_IO_NR31] = 0xFF,
+        [GB15_IO_NR32] = 0x9F,
+        [GB15_IO_NR33] = 0xFF,
+        [GB15_IO_NR34] = 0xBF,
+        [GB15_IO_NR41] = 0xFF,
+        [GB15_IO_NR44] = 0xBF,
+        [GB15_IO_NR50] = 0x77,
+        [GB15_IO_NR51] = 0xF3,
+        [GB15_IO_NR52] = 0xF1,
+        [GB15_IO_LCDC] = 0x91,
+        [GB15_IO_STAT] = 0x85,
+        [GB15_IO_DMA] =  0xFF,
+        [GB15_IO_BGP] =  0xFC,
+        [GB15_IO_OBP0] = 0xFF,
+        [GB15_IO_OBP1] = 0xFF,
+};
+
+/**
+ * DIV has been counting for the whole boot ROM run
+ */
+#define POST_BOOT_DIV 0xAB
+
+/**
+ * Where the boot ROM keeps the registered mark drawn after the logo
+ */
+#define BIOS_MARK 0x00D8
+
+/**
+ * Logo nibbles are scaled up 2x: every bit doubled across a byte, every row written twice
+ */
+static u8 scale_nibble(u8 nibble) {
+    u8 scaled = 0;
+    for (u8 bit = 0; bit < 4; bit++) {
+        if (nibble & ((u8)1 << bit)) {
+            scaled |= (u8)0x03 << (bit * 2);
+        }
+    }
+    return scaled;
+}
+
+/**
+ * Tiles 1-24 hold the logo from the cartridge header and tile 25 the mark, both in the low bit
+ * plane only. The map shows them in two rows of 12 in the middle of the screen. VRAM is written
+ * directly, since a freshly booted GPU has every tile marked for decoding.
+ */
+static void draw_logo(GB15Mmu *mmu) {
+    u8 *vram = mmu->vram[0];
+    u8 *tile = vram + 0x0010;
+    for (u16 address = 0x0104; address < (u16)0x0134; address++) {
+        u8 value = gb15_mmu_read(mmu, address);
+        u8 high = scale_nibble(value >> 4);
+        u8 low = scale_nibble(value & (u8)0x0F);
+        tile[0] = high;
+        tile[2] = high;
+        tile[4] = low;
+        tile[6] = low;
+        tile += 8;
+    }
+    for (u16 i = 0; i < 8; i++) {
+        tile[i * 2] = GB15_BIOS[BIOS_MARK + i];
+    }
+    for (u8 i = 0; i < 12; i++) {
+        vram[0x1904 + i] = i + (u8)1;
+        vram[0x1924 + i] = i + (u8)13;
+    }
+    vram[0x1910] = 25;
+}
+
+void gb15_bios_skip(GB15State *state) {
+    GB15Cpu *cpu = &state->cpu;
+    GB15Mmu *mmu = &state->mmu;
+
+    memcpy(mmu->io, POST_BOOT_IO, sizeof(mmu->io));
+    mmu->div_base = state->scheduler.cycles - ((u64)POST_BOOT_DIV << 6);
+    gb15_mmu_write(mmu, (u16)0xFF00 | GB15_IO_BIOS, 0x01);
+    draw_logo(mmu);
+
+    cpu->pc = 0x0100;
+    cpu->sp = 0xFFFE;
+    cpu->ime = false;
+    cpu->flags_op = GB15_FLAGS_NONE;
+#ifndef GB15_DMG_ONLY
+    if (mmu->cgb) {
+        cpu->af = 0x1180;
+        cpu->bc = 0x0000;
+        cpu->de = 0xFF56;
+        cpu->hl = 0x000D;
+        return;
+    }
+#endif
+    // Half carry and carry are left over from the header checksum, and clear only when it is zero
+    u8 checksum = state->cartridge != NULL? state->cartridge->header.header_checksum : (u8)0;
+    cpu->af = checksum != 0? 0x01B0 : 0x0180;
+    cpu->bc = 0x0013;
+    cpu->de = 0x00D8;
+    cpu->hl = 0x014D;
+}
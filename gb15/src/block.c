@@ -0,0 +1,92 @@
+#include <gb15/block.h>
+
+#include "util.h"
+
+#ifdef GB15_JIT
+#include "jit.h"
+#endif
+
+static inline void drop_block(GB15Block *block) {
+    block->length = 0;
+    block->native = NULL;
+#ifdef GB15_JIT
+    block->hits = 0;
+#endif
+}
+
+bool gb15_block_cache_init(GB15BlockCache *cache) {
+    if (cache->blocks == NULL) {
+        cache->blocks = gb15_pages_alloc(sizeof(GB15Block) * GB15_BLOCK_CACHE_SIZE);
+        if (cache->blocks == NULL) {
+            return false;
+        }
+    }
+    for (u32 i = 0; i < GB15_BLOCK_CACHE_SIZE; i++) {
+        drop_block(cache->blocks + i);
+    }
+    drop_block(&cache->scratch);
+#ifdef GB15_JIT
+    gb15_jit_init(cache);
+#endif
+    return true;
+}
+
+void gb15_block_cache_release(GB15BlockCache *cache) {
+    gb15_pages_free(cache->blocks, sizeof(GB15Block) * GB15_BLOCK_CACHE_SIZE);
+    cache->blocks = NULL;
+#ifdef GB15_JIT
+    gb15_jit_release(cache);
+#endif
+}
+
+GB15Block *gb15_block_cache_slot(GB15BlockCache *cache, u32 key) {
+    return cache->blocks + ((key ^ (key >> 16) * (u32)0x9E5) & (u32)(GB15_BLOCK_CACHE_SIZE - 1));
+}
+
+GB15NativeBlock gb15_block_cache_recompiled(GB15BlockCache *cache, u16 pc) {
+    if (cache->recompiled == NULL) {
+        return NULL;
+    }
+    const GB15RecompiledEntry *entries = cache->recompiled->entries;
+    u32 low = 0;
+    u32 high = cache->recompiled->count;
+    while (low < high) {
+        u32 mid = (low + high) >> 1;
+        if (entries[mid].pc < pc) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < cache->recompiled->count && entries[low].pc == pc) {
+        return entries[low].run;
+    }
+    return NULL;
+}
+
+void gb15_block_cache_flush(GB15BlockCache *cache, GB15Mmu *mmu) {
+    mmu->code_written = false;
+    bool written = false;
+    for (u32 i = 0; i < 256; i++) {
+        written |= mmu->code_pages[i] == GB15_CODE_WRITTEN;
+    }
+    if (!written) { // a ROM bank switch only needs the run loop to leave its block
+        return;
+    }
+    for (u32 i = 0; i < GB15_BLOCK_CACHE_SIZE; i++) {
+        GB15Block *block = cache->blocks + i;
+        if (block->length == 0) {
+            continue;
+        }
+        u8 first = (u8)(block->ops[0].pc >> 8);
+        u8 last = (u8)((u16)(block->ops[block->length - 1].next - (u16)1) >> 8);
+        if (mmu->code_pages[first] == GB15_CODE_WRITTEN || mmu->code_pages[last] == GB15_CODE_WRITTEN) {
+            drop_block(block);
+        }
+    }
+    for (u32 i = 0; i < 256; i++) {
+        if (mmu->code_pages[i] == GB15_CODE_WRITTEN) {
+            mmu->code_pages[i] = GB15_CODE_NONE;
+        }
+    }
+}
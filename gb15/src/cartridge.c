@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <gb15/cartridge.h>
+
+/**
+ * The header fits in bank 0, and a cartridge has at least two banks
+ */
+#define MIN_ROM_SIZE ((uz)0x8000)
+
+static GB15Mbc mbc_for_type(u8 type) {
+    switch (type) {
+        case 0x01 ... 0x03:
+            return GB15_MBC1;
+        case 0x05 ... 0x06:
+            return GB15_MBC2;
+        case 0x0F ... 0x13:
+            return GB15_MBC3;
+        case 0x19 ... 0x1E:
+            return GB15_MBC5;
+        default:
+            return GB15_MBC_NONE;
+    }
+}
+
+static bool battery_for_type(u8 type) {
+    switch (type) {
+        case 0x03:
+        case 0x06:
+        case 0x09:
+        case 0x0D:
+        case 0x0F ... 0x10:
+        case 0x13:
+        case 0x1B:
+        case 0x1E:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * 8KB banks for each 0x0149 RAM size code. Code 1 is a 2KB chip, rounded up to a bank.
+ */
+static const u8 RAM_BANKS[6] = {0, 1, 1, 4, 16, 8};
+
+bool gb15_cartridge_parse_header(GB15CartridgeHeader *header, const u8 *rom, uz size) {
+    if (size < MIN_ROM_SIZE) {
+        return false;
+    }
+    u8 checksum = 0;
+    for (u16 address = 0x0134; address <= (u16)0x014C; address++) {
+        checksum = checksum - rom[address] - (u8)1;
+    }
+    header->header_checksum = rom[0x014D];
+    header->global_checksum = ((u16)rom[0x014E] << 8) | (u16)rom[0x014F];
+    if (checksum != header->header_checksum) {
+        return false;
+    }
+
+    header->cgb = rom[0x0143];
+    uz title_length = (header->cgb & GB15_CGB_SUPPORTED)? 15 : 16;
+    memset(header->title, 0, sizeof(header->title));
+    for (uz i = 0; i < title_length && rom[0x0134 + i] != 0; i++) {
+        header->title[i] = (char)rom[0x0134 + i];
+    }
+
+    header->type = rom[0x0147];
+    header->mbc = mbc_for_type(header->type);
+    header->battery = battery_for_type(header->type);
+    header->rtc = header->type == (u8)0x0F || header->type == (u8)0x10;
+    header->rom_banks = rom[0x0148] <= 0x08? (u16)2 << rom[0x0148] : (u16)2;
+    if (header->mbc == GB15_MBC2) {
+        header->ram_banks = 0;
+        header->ram_size = 512;
+    } else {
+        header->ram_banks = rom[0x0149] < sizeof(RAM_BANKS)? RAM_BANKS[rom[0x0149]] : (u8)0;
+        header->ram_size = (u32)header->ram_banks * 8192;
+    }
+    return size >= (uz)header->rom_banks << 14;
+}
+
+GB15Cartridge *gb15_cartridge_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)MIN_ROM_SIZE) {
+        close(fd);
+        return NULL;
+    }
+    uz size = (uz)info.st_size;
+    void *rom = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (rom == MAP_FAILED) {
+        return NULL;
+    }
+    GB15Cartridge *cartridge = malloc(sizeof(GB15Cartridge));
+    if (cartridge == NULL || !gb15_cartridge_parse_header(&cartridge->header, rom, size)) {
+        free(cartridge);
+        munmap(rom, size);
+        return NULL;
+    }
+    cartridge->rom = rom;
+    cartridge->size = size;
+    cartridge->refs = 1;
+    return cartridge;
+}
+
+GB15Cartridge *gb15_cartridge_retain(GB15Cartridge *cartridge) {
+    __atomic_add_fetch(&cartridge->refs, 1, __ATOMIC_RELAXED);
+    return cartridge;
+}
+
+void gb15_cartridge_release(GB15Cartridge *cartridge) {
+    if (cartridge == NULL || __atomic_sub_fetch(&cartridge->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    munmap((void *)cartridge->rom, cartridge->size);
+    free(cartridge);
+}
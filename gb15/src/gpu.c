@@ -3,118 +3,498 @@
 #include <gb15/gpu.h>
 #include <gb15/gb15.h>
 
+#include "pixels.h"
 #include "util.h"
 
-void gb15_gpu_init(GB15State *state)
+/**
+ * Bytes of decoded tiles across all banks
+ */
+#define TILES_SIZE (GB15_VRAM_BANKS * GB15_TILES * 64)
+
+/**
+ * Line timings in dots, scheduled in machine cycles
+ */
+#define DOTS(n) ((n) / GB15_DOTS_PER_CYCLE)
+#define LINE_CYCLES DOTS(456)
+#define OAM_SCAN_CYCLES DOTS(80)
+#define TRANSFER_CYCLES DOTS(172)
+
+/**
+ * Palette lookup kernel, resolved for the host CPU by the first gb15_gpu_init
+ */
+static GB15PixelsMap pixels_map;
+
+bool gb15_gpu_init(GB15State *state)
 {
-    memset(state->gpu.lcd, 0xFF, sizeof(u32) * 23040);
-}
-
-static u8 bg_palette_for_data(u8 data, u8 bgp) {
-    switch (data) {
-        case 0x00:
-            return bgp & (u8)0x03;
-        case 0x01:
-            return (bgp & (u8)0x0C) >> (u8)2;
-        case 0x02:
-            return (bgp & (u8)0x30) >> (u8)4;
-        case 0x03:
-            return (bgp & (u8)0xC0) >> (u8)6;
-        default:
-            break;
+    if (pixels_map == NULL) {
+        pixels_map = gb15_pixels_map_kernel();
     }
-    return 0;
-}
-
-static u32 bg_pixel_at(GB15Mmu *mmu, u8 x, u8 y, u8 lcdc, u8 scx, u8 scy, u8 bgp) {
-    u16 bg_tile_map_table = (lcdc & 0x08)? (u16)0x9C00 : (u16)0x9800;
-    u8 tile_x = (x + scx) >> (u8)3; // / 8;
-    u8 tile_y = (y + scy) >> (u8)3; // / 8
-    u16 tile_idx = ((u16)tile_y << (u16)5) + (u16)tile_x; // * 32 + tile_x
-    u8 tile_code = gb15_mmu_read(mmu, NULL, bg_tile_map_table + tile_idx);
-    u16 bg_pattern_table = (lcdc & (u8)0x10)? ((u16)0x8000 + (tile_code * (u16)16)) : (u16)((s16)0x9000 + (signify8(tile_code) * (s16)16));
-    u8 char_x = (x + scx) & (u8)0x07;            // % 8
-    u8 char_y = ((y + scy) & (u8)0x07) << (u8)1; // % 8 * 2
-    u8 bitlow = (u8)((gb15_mmu_read(mmu, NULL, bg_pattern_table + char_y) & ((u8)0x80 >> char_x)) != (u8)0);
-    u8 bithigh = (u8)((gb15_mmu_read(mmu, NULL, bg_pattern_table + char_y + (u16)1) & ((u8)0x80 >> char_x)) != (u8)0);
-    switch (bg_palette_for_data((bithigh << (u8)1) | bitlow, bgp)) {
-        case 0x00:
-            return 0xFFFFFFFF;
-        case 0x01:
-            return 0xAAAAAAFF;
-        case 0x02:
-            return 0x555555FF;
-        case 0x03:
-            return 0x000000FF;
-        default:
-            break;
+    if (state->gpu.lcd == NULL) {
+        state->gpu.lcd = gb15_pages_alloc(sizeof(u32) * GB15_LCD_PIXELS);
+        if (state->gpu.lcd == NULL) {
+            return false;
+        }
     }
-    return 0x000000FF;
+    if (state->gpu.tiles == NULL) {
+        state->gpu.tiles = gb15_pages_alloc(TILES_SIZE);
+        if (state->gpu.tiles == NULL) {
+            return false;
+        }
+    }
+    memset(state->gpu.lcd, 0xFF, sizeof(u32) * GB15_LCD_PIXELS);
+    memset(state->gpu.tile_dirty, 0xFF, sizeof(state->gpu.tile_dirty));
+    state->gpu.enabled = false;
+    state->gpu.window_line = 0;
+#ifndef GB15_DMG_ONLY
+    // Palette RAM starts out white
+    memset(state->gpu.palette_memory, 0xFF, sizeof(state->gpu.palette_memory));
+    for (u8 i = 0; i < 32; i++) {
+        state->gpu.colors[0][i] = GB15_RGB555[0x7FFF];
+        state->gpu.colors[1][i] = GB15_RGB555[0x7FFF];
+    }
+#endif
+    gb15_scheduler_schedule(&state->scheduler, GB15_EVENT_GPU_LINE, state->scheduler.cycles + LINE_CYCLES);
+    return true;
 }
 
-void gb15_gpu_tick(GB15State *state, u8 *rom, GB15VBlankCallback vblank, void *userdata) {
-    GB15Gpu *gpu = &state->gpu;
-    GB15Mmu *mmu = &state->mmu;
-    u8 lcdc = mmu->io[GB15_IO_LCDC];
-    if ((lcdc & (u8)0x80) == (u8)0x00) {
-        mmu->io[GB15_IO_LY] = 0x00;
-        mmu->io[GB15_IO_STAT] &= ~(u8)0x03;
-        gpu->clocks = 456;
+void gb15_gpu_release(GB15State *state) {
+    gb15_pages_free(state->gpu.lcd, sizeof(u32) * GB15_LCD_PIXELS);
+    gb15_pages_free(state->gpu.tiles, TILES_SIZE);
+    state->gpu.lcd = NULL;
+    state->gpu.tiles = NULL;
+}
+
+/**
+ * DMG shades, lightest first, as RGBA
+ */
+static const u32 SHADES[4] = {0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF, 0x000000FF};
+
+/**
+ * Index of the tile a map code points at. LCDC bit 4 picks unsigned codes from 0x8000 or signed
+ * ones around 0x9000.
+ */
+static inline u16 tile_index(u8 lcdc, u8 code) {
+    if (lcdc & (u8)0x10) {
+        return code;
+    }
+    return (u16)((s16)256 + signify8(code));
+}
+
+/**
+ * Decoded pixels of one row of a tile. A tile with any row written since it was last decoded has
+ * those rows decoded first.
+ */
+static inline const u8 *tile_row(GB15Mmu *mmu, GB15Gpu *gpu, u8 bank, u16 tile, u8 row) {
+    uz index = (uz)bank * GB15_TILES + tile;
+    u8 *pixels = gpu->tiles + (index << 6);
+    if (gpu->tile_dirty[index]) {
+        gb15_pixels_decode_tile(pixels, mmu->vram[bank] + ((uz)tile << 4), gpu->tile_dirty[index]);
+        gpu->tile_dirty[index] = 0;
+    }
+    return pixels + ((uz)row << 3);
+}
+
+/**
+ * Map a DMG palette register onto the shades
+ */
+static inline void dmg_palette(u32 *palette, u8 value) {
+    for (u8 i = 0; i < 4; i++) {
+        palette[i] = SHADES[(value >> (i * 2)) & (u8)0x03];
+    }
+}
+
+/**
+ * Tiles of the 32x32 tile map LCDC picked for a layer, from the row holding y. Gameboy Color keeps
+ * the attributes of each tile at the same offset in bank 1.
+ */
+static inline u16 map_row(bool high, u8 y) {
+    return (u16)((high? 0x1C00 : 0x1800) + ((y >> 3) << 5));
+}
+
+/**
+ * True when the game runs with Gameboy Color features, never with GB15_DMG_ONLY
+ */
+static inline bool cgb_mode(GB15Mmu *mmu) {
+#ifdef GB15_DMG_ONLY
+    return false;
+#else
+    return mmu->cgb;
+#endif
+}
+
+/**
+ * A row of a tile as 8 color numbers in memory order, leftmost first unless the X flip of the
+ * attribute is set. Map attributes and OAM share the flip bits.
+ */
+static inline u64 flipped_row(GB15Mmu *mmu, GB15Gpu *gpu, u8 bank, u16 tile, u8 row, u8 attribute) {
+    u64 pixels;
+    memcpy(&pixels, tile_row(mmu, gpu, bank, tile, row), 8);
+    if (attribute & GB15_OAM_FLAG_FLIPH) {
+        pixels = __builtin_bswap64(pixels);
+    }
+    return pixels;
+}
+
+/**
+ * The background or window across a line, a tile at a time, before objects go over it. Color
+ * numbers are kept for object priority. On Gameboy Color each tile is mapped through its own
+ * palette as it is fetched, and its attributes are kept for priority too.
+ */
+typedef struct TileLine {
+    u8 index[21 * 8];
+#ifndef GB15_DMG_ONLY
+    u8 attribute[21 * 8];
+    u32 color[21 * 8];
+#endif
+} TileLine;
+
+/**
+ * Gather count tiles along a map row, starting at a column and wrapping past the last one. On the
+ * original Gameboy the patterns always come from bank 0 and the colors are left for later.
+ */
+static void fetch_tiles(GB15Mmu *mmu, GB15Gpu *gpu, TileLine *line, u16 map, u8 column, u8 count, u8 row, u8 lcdc) {
+    const u8 *codes = mmu->vram[0] + map;
+#ifndef GB15_DMG_ONLY
+    if (mmu->cgb) {
+        const u8 *attributes = mmu->vram[1] + map;
+        for (u8 i = 0; i < count; i++) {
+            u8 at = (column + i) & (u8)0x1F;
+            u8 attribute = attributes[at];
+            u8 bank = (attribute & GB15_OAM_FLAG_CHR)? (u8)1 : (u8)0;
+            u8 flipped = (attribute & GB15_OAM_FLAG_FLIPV)? (u8)7 - row : row;
+            u64 pixels = flipped_row(mmu, gpu, bank, tile_index(lcdc, codes[at]), flipped, attribute);
+            memcpy(line->index + i * 8, &pixels, 8);
+            memset(line->attribute + i * 8, attribute, 8);
+            pixels_map(line->color + i * 8, line->index + i * 8, gpu->colors[0] + (attribute & GB15_OAM_FLAG_CGB_COLOR) * 4, 8);
+        }
         return;
     }
-    u8 stat = mmu->io[GB15_IO_STAT];
-    u8 ly = mmu->io[GB15_IO_LY];
-    u8 mode;
-    if (ly >= 144) {
-        mode = 0x01;
-        gpu->stat_raised = false;
-    } else if (gpu->clocks >= 456 - 80) {
-        mode = 0x02;
-        gpu->stat_raised = false;
-    } else if (gpu->clocks >= 456 - 80 - 172) {
-        mode = 0x03;
-        gpu->stat_raised = false;
-    } else {
-        mode = 0x00;
-        if (!gpu->stat_raised && (stat & (u8)0x08)) {
-            mmu->io[GB15_IO_IF] |= (u8)0x02; // stat
-            gpu->stat_raised = true;
+#endif
+    for (u8 i = 0; i < count; i++) {
+        memcpy(line->index + i * 8, tile_row(mmu, gpu, 0, tile_index(lcdc, codes[(column + i) & 0x1F]), row), 8);
+    }
+}
+
+/**
+ * Copy count pixels of the window over the background
+ */
+static void copy_tiles(GB15Mmu *mmu, TileLine *to, u8 at, const TileLine *from, u8 offset, u8 count) {
+    memcpy(to->index + at, from->index + offset, count);
+#ifndef GB15_DMG_ONLY
+    if (mmu->cgb) {
+        memcpy(to->attribute + at, from->attribute + offset, count);
+        memcpy(to->color + at, from->color + offset, sizeof(u32) * count);
+    }
+#endif
+}
+
+/**
+ * Draw the background and window of a line a tile row at a time. The 21 tiles the background can
+ * touch are gathered, and the window is copied over them from WX. Returns where the 160 visible
+ * pixels start, past the fine scroll.
+ * The LCD has its own path to VRAM, which OAM DMA does not lock, so VRAM is read directly.
+ */
+static u8 draw_tiles(GB15Mmu *mmu, GB15Gpu *gpu, TileLine *line, u8 ly, u8 lcdc) {
+    if (!cgb_mode(mmu) && (lcdc & (u8)0x01) == 0) { // background and window off
+        memset(line->index, 0, 160);
+        return 0;
+    }
+    u8 scx = mmu->io[GB15_IO_SCX];
+    u8 y = ly + mmu->io[GB15_IO_SCY];
+    fetch_tiles(mmu, gpu, line, map_row(lcdc & (u8)0x08, y), scx >> 3, 21, y & (u8)0x07, lcdc);
+    u8 start = scx & (u8)0x07;
+
+    u8 wx = mmu->io[GB15_IO_WX];
+    if ((lcdc & (u8)0x20) && ly >= mmu->io[GB15_IO_WY] && wx <= 166) {
+        // The window starts at WX - 7, cut off on the left when WX is below 7
+        TileLine window;
+        u8 wy = gpu->window_line++;
+        fetch_tiles(mmu, gpu, &window, map_row(lcdc & (u8)0x40, wy), 0, (u8)((174 - wx) >> 3), wy & (u8)0x07, lcdc);
+        if (wx < 7) {
+            copy_tiles(mmu, line, start, &window, (u8)(7 - wx), 160);
+        } else {
+            copy_tiles(mmu, line, start + wx - (u8)7, &window, 0, (u8)(167 - wx));
         }
     }
-    gpu->clocks--;
-    if (gpu->clocks == 0) {
-        gpu->clocks += 456;
-        ly++;
-        if (ly == 144) {
-            if (!gpu->vblank_raised) {
-                mmu->io[GB15_IO_IF] |= (u8)0x01; // vblank
-                if (stat & (u8)0x10) {
-                    mmu->io[GB15_IO_IF] |= (u8)0x02; // stat
-                }
-                gpu->vblank_raised = true;
-            }
-            vblank(state, userdata);
-        } else if (ly > 153) {
-            gpu->vblank_raised = false;
-            ly = 0;
+    return start;
+}
+
+/**
+ * Pick the objects on the line the way the LCD does: the first 10 in OAM whose rows cover it,
+ * whether or not they are on screen. The original Gameboy gives priority by X, ties going to the
+ * earlier entry, so they are kept sorted that way when by_x is set. Otherwise OAM order decides.
+ */
+static u8 select_objects(GB15Mmu *mmu, const GB15Oam **selected, u8 ly, u8 height, bool by_x) {
+    const GB15Oam *oam = (const GB15Oam *)(const void *)mmu->oam;
+    u8 count = 0;
+    for (u8 i = 0; i < 40 && count < 10; i++) {
+        if ((u8)(ly + (u8)16 - oam[i].y) >= height) {
+            continue;
+        }
+        u8 at = count++;
+        while (by_x && at > 0 && selected[at - 1]->x > oam[i].x) {
+            selected[at] = selected[at - 1];
+            at--;
         }
-        bool coincidence = (ly == mmu->io[GB15_IO_LYC]);
-        if (coincidence && (stat & (u8)0x40)) {
-            mmu->io[GB15_IO_IF] |= (u8)0x02;
+        selected[at] = oam + i;
+    }
+    return count;
+}
+
+/**
+ * Draw the objects on the line over the background, highest priority first. Each claims its opaque
+ * pixels whether or not it shows through the background there, so an object behind the background
+ * still hides lower priority objects.
+ * The background covers an object where its color is not 0 and either the object or, on Gameboy
+ * Color, the tile has bit 7 of its attributes set. Gameboy Color clears that bit from both when
+ * LCDC bit 0 is off.
+ */
+static void draw_objects(GB15Mmu *mmu, GB15Gpu *gpu, u32 *out, const TileLine *tiles, u8 start, u8 ly, u8 lcdc) {
+    bool cgb = cgb_mode(mmu);
+    u8 height = (lcdc & (u8)0x04)? (u8)16 : (u8)8;
+    const GB15Oam *selected[10];
+    u8 count = select_objects(mmu, selected, ly, height, !cgb);
+    if (count == 0) {
+        return;
+    }
+    u32 dmg[8];
+    dmg_palette(dmg, mmu->io[GB15_IO_OBP0]);
+    dmg_palette(dmg + 4, mmu->io[GB15_IO_OBP1]);
+    const u32 *palettes = dmg;
+    u8 priority = GB15_OAM_FLAG_PRIO;
+#ifndef GB15_DMG_ONLY
+    if (cgb) {
+        palettes = gpu->colors[1];
+        if ((lcdc & (u8)0x01) == 0) {
+            priority = 0;
+        }
+    }
+#endif
+
+    // Indexed by X as OAM holds it, which is 8 past the screen
+    bool claimed[168] = {false};
+    for (u8 i = 0; i < count; i++) {
+        const GB15Oam *object = selected[i];
+        if (object->x == 0 || object->x >= 168) { // off screen, though it still counted
+            continue;
+        }
+        u8 attribute = object->attribute;
+        u8 row = ly + (u8)16 - object->y;
+        if (attribute & GB15_OAM_FLAG_FLIPV) {
+            row = height - (u8)1 - row;
         }
-        stat = (stat & ~(u8)0x04) | coincidence;
-        if (ly < 144) {
-            if (lcdc & 0x01) {
-                u8 scx = mmu->io[GB15_IO_SCX];
-                u8 scy = mmu->io[GB15_IO_SCY];
-                u8 bgp = mmu->io[GB15_IO_BGP];
-                for (u8 x = 0; x < 160; x++) {
-                    gpu->lcd[ly * 160 + x] = bg_pixel_at(mmu, x, ly, lcdc, scx, scy, bgp);
-                }
+        u8 chr = height == 16? object->chr & (u8)0xFE : object->chr;
+        u8 bank = (cgb && (attribute & GB15_OAM_FLAG_CHR))? (u8)1 : (u8)0;
+        u64 pixels = flipped_row(mmu, gpu, bank, (u16)(chr + (row >> 3)), row & (u8)0x07, attribute);
+        u8 index[8];
+        memcpy(index, &pixels, 8);
+
+        const u32 *palette = palettes + 4 * (cgb? (attribute & GB15_OAM_FLAG_CGB_COLOR) : (attribute & GB15_OAM_FLAG_DMG_COLOR) >> 4);
+        u8 behind = attribute & priority;
+        u8 first = object->x < 8? (u8)(8 - object->x) : (u8)0;
+        u8 last = object->x > 160? (u8)(168 - object->x) : (u8)8;
+        for (u8 bit = first; bit < last; bit++) {
+            u8 x = object->x + bit;
+            if (index[bit] == 0 || claimed[x]) {
+                continue;
+            }
+            claimed[x] = true;
+            u8 at = start + x - (u8)8;
+            u8 covered = behind;
+#ifndef GB15_DMG_ONLY
+            if (cgb) {
+                covered |= tiles->attribute[at] & priority;
+            }
+#endif
+            if (covered == 0 || tiles->index[at] == 0) {
+                out[x - 8] = palette[index[bit]];
             }
         }
     }
-    stat = (stat & ~(u8)0x03) | mode;
+}
+
+static void draw_line(GB15Mmu *mmu, GB15Gpu *gpu, u8 ly) {
+    if (ly >= 144) { // a write to LY can leave a transfer pending past the last line
+        return;
+    }
+    u8 lcdc = mmu->io[GB15_IO_LCDC];
+    u32 *out = gpu->lcd + ly * 160;
+    TileLine tiles;
+    u8 start = draw_tiles(mmu, gpu, &tiles, ly, lcdc);
+#ifndef GB15_DMG_ONLY
+    if (mmu->cgb) {
+        memcpy(out, tiles.color + start, sizeof(u32) * 160);
+    }
+#endif
+    if (!cgb_mode(mmu)) {
+        u32 palette[4];
+        dmg_palette(palette, (lcdc & (u8)0x01)? mmu->io[GB15_IO_BGP] : (u8)0x00);
+        pixels_map(out, tiles.index + start, palette, 160);
+    }
+    if (lcdc & (u8)0x02) {
+        draw_objects(mmu, gpu, out, &tiles, start, ly, lcdc);
+    }
+}
+
+static inline void set_mode(GB15Mmu *mmu, u8 mode) {
+    mmu->io[GB15_IO_STAT] = (mmu->io[GB15_IO_STAT] & ~(u8)0x03) | mode;
+}
+
+static void lcd_off(GB15State *state, u64 when) {
+    GB15Mmu *mmu = &state->mmu;
+    state->gpu.enabled = false;
+    mmu->io[GB15_IO_LY] = 0x00;
+    set_mode(mmu, 0x00);
+    gb15_scheduler_cancel(&state->scheduler, GB15_EVENT_GPU_TRANSFER);
+    gb15_scheduler_cancel(&state->scheduler, GB15_EVENT_GPU_HBLANK);
+    gb15_scheduler_schedule(&state->scheduler, GB15_EVENT_GPU_LINE, when + LINE_CYCLES);
+}
+
+/**
+ * Compare LY against LYC, raising the STAT interrupt when they come to match and it is enabled
+ */
+static void check_coincidence(GB15Mmu *mmu) {
+    u8 stat = mmu->io[GB15_IO_STAT];
+    bool coincidence = (mmu->io[GB15_IO_LY] == mmu->io[GB15_IO_LYC]);
+    if (coincidence && (stat & (u8)0x40)) {
+        mmu->io[GB15_IO_IF] |= (u8)0x02; // stat
+    }
+    mmu->io[GB15_IO_STAT] = (stat & ~(u8)0x04) | ((u8)coincidence << (u8)2);
+}
+
+static void line(GB15State *state, u64 when, GB15VBlankCallback vblank, void *userdata) {
+    GB15Gpu *gpu = &state->gpu;
+    GB15Mmu *mmu = &state->mmu;
+    u8 ly = mmu->io[GB15_IO_LY];
+    if (!gpu->enabled) {
+        gpu->enabled = true;
+        ly = 0;
+    } else if (++ly > 153) {
+        ly = 0;
+    }
     mmu->io[GB15_IO_LY] = ly;
-    mmu->io[GB15_IO_STAT] = stat;
-}
\ No newline at end of file
+    if (ly == 0) {
+        gpu->window_line = 0;
+    }
+    u8 stat = mmu->io[GB15_IO_STAT];
+    check_coincidence(mmu);
+    gb15_scheduler_schedule(&state->scheduler, GB15_EVENT_GPU_LINE, when + LINE_CYCLES);
+    if (ly < 144) {
+        set_mode(mmu, 0x02);
+        if (stat & (u8)0x20) {
+            mmu->io[GB15_IO_IF] |= (u8)0x02; // stat
+        }
+        gb15_scheduler_schedule(&state->scheduler, GB15_EVENT_GPU_TRANSFER, when + OAM_SCAN_CYCLES);
+    } else if (ly == 144) {
+        set_mode(mmu, 0x01);
+        mmu->io[GB15_IO_IF] |= (u8)0x01; // vblank
+        if (stat & (u8)0x10) {
+            mmu->io[GB15_IO_IF] |= (u8)0x02; // stat
+        }
+        vblank(state, userdata);
+    }
+}
+
+void gb15_gpu_event(GB15State *state, GB15EventType type, u64 when, GB15VBlankCallback vblank, void *userdata) {
+    GB15Mmu *mmu = &state->mmu;
+    if ((mmu->io[GB15_IO_LCDC] & (u8)0x80) == (u8)0x00) {
+        lcd_off(state, when);
+        return;
+    }
+    switch (type) {
+        case GB15_EVENT_GPU_TRANSFER:
+            set_mode(mmu, 0x03);
+            gb15_scheduler_schedule(&state->scheduler, GB15_EVENT_GPU_HBLANK, when + TRANSFER_CYCLES);
+            break;
+        case GB15_EVENT_GPU_HBLANK:
+            set_mode(mmu, 0x00);
+            draw_line(mmu, &state->gpu, mmu->io[GB15_IO_LY]);
+#ifndef GB15_DMG_ONLY
+            state->scheduler.cycles += gb15_mmu_hdma_hblank(mmu);
+#endif
+            if (mmu->io[GB15_IO_STAT] & (u8)0x08) {
+                mmu->io[GB15_IO_IF] |= (u8)0x02; // stat
+            }
+            break;
+        case GB15_EVENT_GPU_LINE:
+            line(state, when, vblank, userdata);
+            break;
+        default:
+            break;
+    }
+}
+
+void gb15_gpu_write_lcdc(GB15State *state, u8 port, u8 value) {
+    GB15Mmu *mmu = &state->mmu;
+    u8 lcdc = mmu->io[GB15_IO_LCDC];
+    mmu->io[GB15_IO_LCDC] = value;
+    if ((lcdc & (u8)0x80) && !(value & (u8)0x80)) {
+        // Turning the LCD on waits for the next line event, but turning it off is immediate
+        lcd_off(state, state->scheduler.cycles);
+    }
+}
+
+/**
+ * The mode and coincidence bits are read-only
+ */
+void gb15_gpu_write_stat(GB15State *state, u8 port, u8 value) {
+    GB15Mmu *mmu = &state->mmu;
+    mmu->io[GB15_IO_STAT] = (value & (u8)0x78) | (mmu->io[GB15_IO_STAT] & (u8)0x07);
+}
+
+void gb15_gpu_write_lyc(GB15State *state, u8 port, u8 value) {
+    GB15Mmu *mmu = &state->mmu;
+    mmu->io[GB15_IO_LYC] = value;
+    if (!state->gpu.enabled) {
+        return;
+    }
+    if (mmu->io[GB15_IO_STAT] & (u8)0x04) {
+        // Already matching, so only the flag can change
+        if (mmu->io[GB15_IO_LY] != value) {
+            mmu->io[GB15_IO_STAT] &= ~(u8)0x04;
+        }
+    } else {
+        check_coincidence(mmu);
+    }
+}
+
+#ifndef GB15_DMG_ONLY
+/**
+ * Bit 6 of BCPS and OCPS is unused and reads set
+ */
+void gb15_gpu_write_cps(GB15State *state, u8 port, u8 value) {
+    if (!state->mmu.cgb) {
+        return;
+    }
+    state->mmu.io[port] = value | (u8)0x40;
+}
+
+u8 gb15_gpu_read_cpd(GB15State *state, u8 port) {
+    GB15Mmu *mmu = &state->mmu;
+    if (!mmu->cgb) {
+        return 0xFF;
+    }
+    return state->gpu.palette_memory[port == GB15_IO_OCPD][mmu->io[port - 1] & (u8)0x3F];
+}
+
+/**
+ * Store a byte of palette RAM and convert the color it belongs to, the only time that color is
+ * converted
+ */
+void gb15_gpu_write_cpd(GB15State *state, u8 port, u8 value) {
+    GB15Mmu *mmu = &state->mmu;
+    if (!mmu->cgb) {
+        return;
+    }
+    u8 layer = port == GB15_IO_OCPD;
+    u8 spec = mmu->io[port - 1];
+    u8 index = spec & (u8)0x3F;
+    u8 *memory = state->gpu.palette_memory[layer];
+    memory[index] = value;
+    u8 color = index >> 1;
+    state->gpu.colors[layer][color] = GB15_RGB555[(memory[color * 2] | (memory[color * 2 + 1] << 8)) & 0x7FFF];
+    if (spec & (u8)0x80) {
+        mmu->io[port - 1] = (spec & (u8)0xC0) | ((index + (u8)1) & (u8)0x3F);
+    }
+}
+#endif
@@ -0,0 +1,763 @@
+#ifndef _GB15_HANDLERS_H_
+#define _GB15_HANDLERS_H_
+
+#include <gb15/cpu.h>
+#include <gb15/mmu.h>
+#include <gb15/gb15.h>
+
+#include "util.h"
+
+/**
+ * Instruction semantics shared by the interpreter and recompiled code
+ */
+
+static inline u8 read8(GB15Mmu *mmu, u16 *pc) {
+    u8 tmp8 = gb15_mmu_read(mmu, *pc);
+    (*pc)++;
+    return tmp8;
+}
+
+static inline u16 read16(GB15Mmu *mmu, u16 *pc) {
+    GB15LongRegister tmp16;
+    tmp16.l = read8(mmu, pc);
+    tmp16.h = read8(mmu, pc);
+    return tmp16.value;
+}
+
+static inline void write16(GB15Mmu *mmu, u16 address, u16 value) {
+    GB15LongRegister tmp16;
+    tmp16.value = value;
+    gb15_mmu_write(mmu, address, tmp16.l);
+    gb15_mmu_write(mmu, address + (u16)1, tmp16.h);
+}
+
+static inline void set_z(GB15Cpu *cpu, bool value) {
+    cpu->f = (cpu->f & (u8)0x7F) | (value << (u8)7);
+}
+
+static inline void set_n(GB15Cpu *cpu, bool value) {
+    cpu->f = (cpu->f & (u8)0xBF) | (value << (u8)6);
+}
+
+static inline void set_h(GB15Cpu *cpu, bool value) {
+    cpu->f = (cpu->f & (u8)0xDF) | (value << (u8)5);
+}
+
+static inline void set_c(GB15Cpu *cpu, bool value) {
+    cpu->f = (cpu->f & (u8)0xEF) | (value << (u8)4);
+}
+
+static inline u8 get_z(GB15Cpu *cpu) {
+    switch (cpu->flags_op) {
+        case GB15_FLAGS_NONE:
+            return (cpu->f & (u8)0x80) >> (u8)7;
+        case GB15_FLAGS_ROTATE_A:
+            return 0;
+        default:
+            return (u8)cpu->flags_result == (u8)0x00;
+    }
+}
+
+static inline u8 get_n(GB15Cpu *cpu) {
+    switch (cpu->flags_op) {
+        case GB15_FLAGS_NONE:
+            return (cpu->f & (u8)0x40) >> (u8)6;
+        case GB15_FLAGS_SUB:
+        case GB15_FLAGS_DEC:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static inline u8 get_h(GB15Cpu *cpu) {
+    switch (cpu->flags_op) {
+        case GB15_FLAGS_NONE:
+            return (cpu->f & (u8)0x20) >> (u8)5;
+        case GB15_FLAGS_ADD:
+        case GB15_FLAGS_SUB:
+        case GB15_FLAGS_INC:
+        case GB15_FLAGS_DEC:
+            return ((cpu->flags_lhs ^ cpu->flags_rhs ^ cpu->flags_result) & (u8)0x10) >> (u8)4;
+        case GB15_FLAGS_AND:
+        case GB15_FLAGS_BIT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static inline u8 get_c(GB15Cpu *cpu) {
+    switch (cpu->flags_op) {
+        case GB15_FLAGS_NONE:
+            return (cpu->f & (u8)0x10) >> (u8)4;
+        case GB15_FLAGS_ADD:
+        case GB15_FLAGS_SUB:
+            return (cpu->flags_result & (u16)0x100) >> (u16)8;
+        case GB15_FLAGS_AND:
+        case GB15_FLAGS_LOGIC:
+            return 0;
+        default:
+            return cpu->flags_carry;
+    }
+}
+
+/**
+ * Record a flag-setting operation instead of computing Z/N/H/C. Most results are overwritten
+ * before anything reads them.
+ */
+static inline void set_lazy(GB15Cpu *cpu, GB15FlagsOp op, u8 lhs, u8 rhs, u16 result, u8 carry) {
+    cpu->flags_op = op;
+    cpu->flags_lhs = lhs;
+    cpu->flags_rhs = rhs;
+    cpu->flags_result = result;
+    cpu->flags_carry = carry;
+}
+
+/**
+ * Must run before set_z/set_n/set_h/set_c or any direct use of f
+ */
+static inline void sync_flags(GB15Cpu *cpu) {
+    if (cpu->flags_op == GB15_FLAGS_NONE) {
+        return;
+    }
+    cpu->f = (get_z(cpu) << (u8)7) | (get_n(cpu) << (u8)6) | (get_h(cpu) << (u8)5) | (get_c(cpu) << (u8)4) | (cpu->f & (u8)0x0F);
+    cpu->flags_op = GB15_FLAGS_NONE;
+}
+
+#define FOR_EACH_REG8(X, arg) X(arg, b) X(arg, c) X(arg, d) X(arg, e) X(arg, h) X(arg, l) X(arg, a)
+
+/**
+ * imm is the decoded immediate operand of the instruction, and pc already points past it
+ */
+#define HANDLER(name) static inline u32 name(GB15Cpu *cpu, GB15Mmu *mmu, u16 imm)
+
+static inline void add_with_carry(GB15Cpu *cpu, u8 value, u8 carry) {
+    u16 result = (u16)cpu->a + (u16)value + (u16)carry;
+    set_lazy(cpu, GB15_FLAGS_ADD, cpu->a, value, result, 0);
+    cpu->a = (u8)result;
+}
+
+static inline void add_core(GB15Cpu *cpu, u8 value) {
+    add_with_carry(cpu, value, 0);
+}
+
+static inline void adc_core(GB15Cpu *cpu, u8 value) {
+    add_with_carry(cpu, value, get_c(cpu));
+}
+
+static inline u8 sub_with_carry(GB15Cpu *cpu, u8 value, u8 carry) {
+    u16 result = (u16)cpu->a - (u16)value - (u16)carry;
+    set_lazy(cpu, GB15_FLAGS_SUB, cpu->a, value, result, 0);
+    return (u8)result;
+}
+
+static inline void sub_core(GB15Cpu *cpu, u8 value) {
+    cpu->a = sub_with_carry(cpu, value, 0);
+}
+
+static inline void sbc_core(GB15Cpu *cpu, u8 value) {
+    cpu->a = sub_with_carry(cpu, value, get_c(cpu));
+}
+
+static inline void and_core(GB15Cpu *cpu, u8 value) {
+    cpu->a &= value;
+    set_lazy(cpu, GB15_FLAGS_AND, 0, 0, cpu->a, 0);
+}
+
+static inline void xor_core(GB15Cpu *cpu, u8 value) {
+    cpu->a ^= value;
+    set_lazy(cpu, GB15_FLAGS_LOGIC, 0, 0, cpu->a, 0);
+}
+
+static inline void or_core(GB15Cpu *cpu, u8 value) {
+    cpu->a |= value;
+    set_lazy(cpu, GB15_FLAGS_LOGIC, 0, 0, cpu->a, 0);
+}
+
+static inline void cp_core(GB15Cpu *cpu, u8 value) {
+    sub_with_carry(cpu, value, 0);
+}
+
+static inline u8 inc_core(GB15Cpu *cpu, u8 value) {
+    u8 result = value + (u8)1;
+    set_lazy(cpu, GB15_FLAGS_INC, value, 1, result, get_c(cpu));
+    return result;
+}
+
+static inline u8 dec_core(GB15Cpu *cpu, u8 value) {
+    u8 result = value - (u8)1;
+    set_lazy(cpu, GB15_FLAGS_DEC, value, 1, result, get_c(cpu));
+    return result;
+}
+
+static inline u8 rlc_core(GB15Cpu *cpu, u8 value) {
+    u8 carry = (value & (u8)0x80) >> (u8)7;
+    value = (value << (u8)1) | carry;
+    set_lazy(cpu, GB15_FLAGS_SHIFT, 0, 0, value, carry);
+    return value;
+}
+
+static inline u8 rrc_core(GB15Cpu *cpu, u8 value) {
+    u8 carry = value & (u8)0x01;
+    value = (value >> (u8)1) | (carry << (u8)7);
+    set_lazy(cpu, GB15_FLAGS_SHIFT, 0, 0, value, carry);
+    return value;
+}
+
+static inline u8 shift_left(GB15Cpu *cpu, u8 value, u8 carry) {
+    u8 result = (value << (u8)1) | carry;
+    set_lazy(cpu, GB15_FLAGS_SHIFT, 0, 0, result, (value & (u8)0x80) >> (u8)7);
+    return result;
+}
+
+static inline u8 shift_right(GB15Cpu *cpu, u8 value, u8 carry) {
+    u8 result = (value >> (u8)1) | (carry << (u8)7);
+    set_lazy(cpu, GB15_FLAGS_SHIFT, 0, 0, result, value & (u8)0x01);
+    return result;
+}
+
+static inline u8 rl_core(GB15Cpu *cpu, u8 value) {
+    return shift_left(cpu, value, get_c(cpu));
+}
+
+static inline u8 rr_core(GB15Cpu *cpu, u8 value) {
+    return shift_right(cpu, value, get_c(cpu));
+}
+
+static inline u8 sla_core(GB15Cpu *cpu, u8 value) {
+    return shift_left(cpu, value, 0);
+}
+
+static inline u8 sra_core(GB15Cpu *cpu, u8 value) {
+    return shift_right(cpu, value, (value & (u8)0x80) >> (u8)7);
+}
+
+static inline u8 swap_core(GB15Cpu *cpu, u8 value) {
+    value = ((value & (u8)0xF0) >> (u8)4) | ((value & (u8)0x0F) << (u8)4);
+    set_lazy(cpu, GB15_FLAGS_SHIFT, 0, 0, value, 0);
+    return value;
+}
+
+static inline u8 srl_core(GB15Cpu *cpu, u8 value) {
+    return shift_right(cpu, value, 0);
+}
+
+static inline void bit_core(GB15Cpu *cpu, u8 value, u8 mask) {
+    set_lazy(cpu, GB15_FLAGS_BIT, 0, 0, value & mask, get_c(cpu));
+}
+
+static inline bool cond_nz(GB15Cpu *cpu) {
+    return !get_z(cpu);
+}
+
+static inline bool cond_z(GB15Cpu *cpu) {
+    return get_z(cpu);
+}
+
+static inline bool cond_nc(GB15Cpu *cpu) {
+    return !get_c(cpu);
+}
+
+static inline bool cond_c(GB15Cpu *cpu) {
+    return get_c(cpu);
+}
+
+static inline u32 rst_core(GB15Cpu *cpu, GB15Mmu *mmu, u16 dest) {
+    cpu->sp -= 2;
+    write16(mmu, cpu->sp, cpu->pc);
+    cpu->pc = dest;
+    return 4;
+}
+
+/**
+ * 8-bit register forms: inc r, dec r, ld r, u8, ld r, (hl), ld (hl), r
+ */
+#define REG8_HANDLERS(unused, r) \
+    HANDLER(inc_##r) { \
+        cpu->r = inc_core(cpu, cpu->r); \
+        return 1; \
+    } \
+    HANDLER(dec_##r) { \
+        cpu->r = dec_core(cpu, cpu->r); \
+        return 1; \
+    } \
+    HANDLER(ld_##r##_u8) { \
+        cpu->r = (u8)imm; \
+        return 2; \
+    } \
+    HANDLER(ld_##r##_mem_hl) { \
+        cpu->r = gb15_mmu_read(mmu, cpu->hl); \
+        return 2; \
+    } \
+    HANDLER(ld_mem_hl_##r) { \
+        gb15_mmu_write(mmu, cpu->hl, cpu->r); \
+        return 2; \
+    }
+
+FOR_EACH_REG8(REG8_HANDLERS, _)
+
+/**
+ * ld dst, src for every register pair
+ */
+#define LD_R_R(dst, src) \
+    HANDLER(ld_##dst##_##src) { \
+        cpu->dst = cpu->src; \
+        return 1; \
+    }
+
+#define LD_R_R_FROM_ALL(unused, dst) \
+    LD_R_R(dst, b) LD_R_R(dst, c) LD_R_R(dst, d) LD_R_R(dst, e) LD_R_R(dst, h) LD_R_R(dst, l) LD_R_R(dst, a)
+
+FOR_EACH_REG8(LD_R_R_FROM_ALL, _)
+
+/**
+ * 16-bit register forms: ld rr, u16, inc rr, dec rr, add hl, rr
+ */
+#define REG16_HANDLERS(rr) \
+    HANDLER(ld_##rr##_u16) { \
+        cpu->rr = imm; \
+        return 3; \
+    } \
+    HANDLER(inc_##rr) { \
+        cpu->rr++; \
+        return 2; \
+    } \
+    HANDLER(dec_##rr) { \
+        cpu->rr--; \
+        return 2; \
+    } \
+    HANDLER(add_hl_##rr) { \
+        u32 overflow = (u32)cpu->hl + (u32)cpu->rr; \
+        sync_flags(cpu); \
+        set_n(cpu, false); \
+        set_c(cpu, overflow > (u32)0xFFFF); \
+        set_h(cpu, (overflow & (u32)0x0FFF) < (cpu->hl & (u32)0x0FFF)); \
+        cpu->hl = (u16)(overflow & (u32)0xFFFF); \
+        return 2; \
+    }
+
+REG16_HANDLERS(bc)
+REG16_HANDLERS(de)
+REG16_HANDLERS(hl)
+REG16_HANDLERS(sp)
+
+#define MEM_RR_HANDLERS(rr) \
+    HANDLER(ld_mem_##rr##_a) { \
+        gb15_mmu_write(mmu, cpu->rr, cpu->a); \
+        return 2; \
+    } \
+    HANDLER(ld_a_mem_##rr) { \
+        cpu->a = gb15_mmu_read(mmu, cpu->rr); \
+        return 2; \
+    }
+
+MEM_RR_HANDLERS(bc)
+MEM_RR_HANDLERS(de)
+
+#define STACK_HANDLERS(rr) \
+    HANDLER(push_##rr) { \
+        cpu->sp -= 2; \
+        write16(mmu, cpu->sp, cpu->rr); \
+        return 4; \
+    } \
+    HANDLER(pop_##rr) { \
+        cpu->rr = read16(mmu, &cpu->sp); \
+        return 3; \
+    }
+
+STACK_HANDLERS(bc)
+STACK_HANDLERS(de)
+STACK_HANDLERS(hl)
+
+HANDLER(push_af) {
+    sync_flags(cpu);
+    cpu->sp -= 2;
+    write16(mmu, cpu->sp, cpu->af);
+    return 4;
+}
+
+HANDLER(pop_af) {
+    // The low nibble of f has no flags behind it and always reads back as zero
+    cpu->af = read16(mmu, &cpu->sp) & (u16)0xFFF0;
+    cpu->flags_op = GB15_FLAGS_NONE;
+    return 3;
+}
+
+/**
+ * 8-bit arithmetic on a: op r, op (hl), op u8
+ */
+#define ALU_REG(op, r) \
+    HANDLER(op##_##r) { \
+        op##_core(cpu, cpu->r); \
+        return 1; \
+    }
+
+#define ALU_HANDLERS(op) \
+    FOR_EACH_REG8(ALU_REG, op) \
+    HANDLER(op##_mem_hl) { \
+        op##_core(cpu, gb15_mmu_read(mmu, cpu->hl)); \
+        return 2; \
+    } \
+    HANDLER(op##_u8) { \
+        op##_core(cpu, (u8)imm); \
+        return 2; \
+    }
+
+ALU_HANDLERS(add)
+ALU_HANDLERS(adc)
+ALU_HANDLERS(sub)
+ALU_HANDLERS(sbc)
+ALU_HANDLERS(and)
+ALU_HANDLERS(xor)
+ALU_HANDLERS(or)
+ALU_HANDLERS(cp)
+
+/**
+ * Conditional control flow: jr cc, jp cc, call cc, ret cc
+ */
+#define COND_HANDLERS(cc) \
+    HANDLER(jr_##cc##_s8) { \
+        if (cond_##cc(cpu)) { \
+            cpu->pc += signify8((u8)imm); \
+            return 3; \
+        } \
+        return 2; \
+    } \
+    HANDLER(jp_##cc##_u16) { \
+        if (cond_##cc(cpu)) { \
+            cpu->pc = imm; \
+            return 4; \
+        } \
+        return 3; \
+    } \
+    HANDLER(call_##cc##_u16) { \
+        if (cond_##cc(cpu)) { \
+            cpu->sp -= 2; \
+            write16(mmu, cpu->sp, cpu->pc); \
+            cpu->pc = imm; \
+            return 6; \
+        } \
+        return 3; \
+    } \
+    HANDLER(ret_##cc) { \
+        if (cond_##cc(cpu)) { \
+            cpu->pc = read16(mmu, &cpu->sp); \
+            return 5; \
+        } \
+        return 2; \
+    }
+
+COND_HANDLERS(nz)
+COND_HANDLERS(z)
+COND_HANDLERS(nc)
+COND_HANDLERS(c)
+
+#define RST_HANDLER(n) \
+    HANDLER(rst_##n) { \
+        return rst_core(cpu, mmu, (u16)0x##n); \
+    }
+
+RST_HANDLER(00)
+RST_HANDLER(08)
+RST_HANDLER(10)
+RST_HANDLER(18)
+RST_HANDLER(20)
+RST_HANDLER(28)
+RST_HANDLER(30)
+RST_HANDLER(38)
+
+/**
+ * CB prefixed rotates and shifts: op r, op (hl)
+ */
+#define CB_REG(op, r) \
+    HANDLER(op##_##r) { \
+        cpu->r = op##_core(cpu, cpu->r); \
+        return 2; \
+    }
+
+#define CB_HANDLERS(op) \
+    FOR_EACH_REG8(CB_REG, op) \
+    HANDLER(op##_mem_hl) { \
+        gb15_mmu_write(mmu, cpu->hl, op##_core(cpu, gb15_mmu_read(mmu, cpu->hl))); \
+        return 4; \
+    }
+
+CB_HANDLERS(rlc)
+CB_HANDLERS(rrc)
+CB_HANDLERS(rl)
+CB_HANDLERS(rr)
+CB_HANDLERS(sla)
+CB_HANDLERS(sra)
+CB_HANDLERS(swap)
+CB_HANDLERS(srl)
+
+/**
+ * CB prefixed single bit operations: bit n, r, res n, r, set n, r and their (hl) forms
+ */
+#define BIT_REG(n, r) \
+    HANDLER(bit_##n##_##r) { \
+        bit_core(cpu, cpu->r, (u8)1 << (u8)n); \
+        return 2; \
+    } \
+    HANDLER(res_##n##_##r) { \
+        cpu->r &= ~((u8)1 << (u8)n); \
+        return 2; \
+    } \
+    HANDLER(set_##n##_##r) { \
+        cpu->r |= (u8)1 << (u8)n; \
+        return 2; \
+    }
+
+#define BIT_HANDLERS(n) \
+    FOR_EACH_REG8(BIT_REG, n) \
+    HANDLER(bit_##n##_mem_hl) { \
+        bit_core(cpu, gb15_mmu_read(mmu, cpu->hl), (u8)1 << (u8)n); \
+        return 3; \
+    } \
+    HANDLER(res_##n##_mem_hl) { \
+        gb15_mmu_write(mmu, cpu->hl, gb15_mmu_read(mmu, cpu->hl) & ~((u8)1 << (u8)n)); \
+        return 4; \
+    } \
+    HANDLER(set_##n##_mem_hl) { \
+        gb15_mmu_write(mmu, cpu->hl, gb15_mmu_read(mmu, cpu->hl) | ((u8)1 << (u8)n)); \
+        return 4; \
+    }
+
+BIT_HANDLERS(0)
+BIT_HANDLERS(1)
+BIT_HANDLERS(2)
+BIT_HANDLERS(3)
+BIT_HANDLERS(4)
+BIT_HANDLERS(5)
+BIT_HANDLERS(6)
+BIT_HANDLERS(7)
+
+HANDLER(nop) {
+    return 1;
+}
+
+HANDLER(rlca) {
+    cpu->a = rlc_core(cpu, cpu->a);
+    cpu->flags_op = GB15_FLAGS_ROTATE_A;
+    return 1;
+}
+
+HANDLER(ld_mem_u16_sp) {
+    write16(mmu, imm, cpu->sp);
+    return 5;
+}
+
+HANDLER(rrca) {
+    cpu->a = rrc_core(cpu, cpu->a);
+    cpu->flags_op = GB15_FLAGS_ROTATE_A;
+    return 1;
+}
+
+HANDLER(stop) {
+    cpu->stopped = true;
+    return 1;
+}
+
+HANDLER(rla) {
+    cpu->a = rl_core(cpu, cpu->a);
+    cpu->flags_op = GB15_FLAGS_ROTATE_A;
+    return 1;
+}
+
+HANDLER(jr_s8) {
+    cpu->pc += signify8((u8)imm);
+    return 3;
+}
+
+HANDLER(rra) {
+    cpu->a = rr_core(cpu, cpu->a);
+    cpu->flags_op = GB15_FLAGS_ROTATE_A;
+    return 1;
+}
+
+HANDLER(ldi_hl_a) {
+    gb15_mmu_write(mmu, cpu->hl, cpu->a);
+    cpu->hl++;
+    return 2;
+}
+
+HANDLER(daa) {
+    sync_flags(cpu);
+    if (get_n(cpu)) {
+        if (get_c(cpu)) {
+            cpu->a -= (u8)0x60;
+        }
+        if (get_h(cpu)) {
+            cpu->a -= (u8)0x06;
+        }
+    } else {
+        if (get_c(cpu) || cpu->a > (u8)0x99) {
+            cpu->a += (u8)0x60;
+            set_c(cpu, true);
+        }
+        if (get_h(cpu) || (cpu->a & (u8)0x0F) > (u8)0x09) {
+            cpu->a += (u8)0x06;
+        }
+    }
+    set_h(cpu, false);
+    set_z(cpu, cpu->a == (u8)0x00);
+    return 1;
+}
+
+HANDLER(ldi_a_hl) {
+    cpu->a = gb15_mmu_read(mmu, cpu->hl);
+    cpu->hl++;
+    return 2;
+}
+
+HANDLER(cpl) {
+    sync_flags(cpu);
+    cpu->a = ~cpu->a;
+    set_n(cpu, true);
+    set_h(cpu, true);
+    return 1;
+}
+
+HANDLER(ldd_hl_a) {
+    gb15_mmu_write(mmu, cpu->hl, cpu->a);
+    cpu->hl--;
+    return 2;
+}
+
+HANDLER(inc_mem_hl) {
+    gb15_mmu_write(mmu, cpu->hl, inc_core(cpu, gb15_mmu_read(mmu, cpu->hl)));
+    return 3;
+}
+
+HANDLER(dec_mem_hl) {
+    gb15_mmu_write(mmu, cpu->hl, dec_core(cpu, gb15_mmu_read(mmu, cpu->hl)));
+    return 3;
+}
+
+HANDLER(ld_mem_hl_u8) {
+    gb15_mmu_write(mmu, cpu->hl, (u8)imm);
+    return 3;
+}
+
+HANDLER(scf) {
+    sync_flags(cpu);
+    set_n(cpu, false);
+    set_h(cpu, false);
+    set_c(cpu, true);
+    return 1;
+}
+
+HANDLER(ldd_a_hl) {
+    cpu->a = gb15_mmu_read(mmu, cpu->hl);
+    cpu->hl--;
+    return 2;
+}
+
+HANDLER(ccf) {
+    sync_flags(cpu);
+    set_n(cpu, false);
+    set_h(cpu, false);
+    set_c(cpu, !get_c(cpu));
+    return 1;
+}
+
+HANDLER(halt) {
+    cpu->halted = true;
+    cpu->halt_flags = mmu->io[GB15_IO_IF];
+    return 1;
+}
+
+HANDLER(jp_u16) {
+    cpu->pc = imm;
+    return 4;
+}
+
+HANDLER(ret) {
+    cpu->pc = read16(mmu, &cpu->sp);
+    return 4;
+}
+
+HANDLER(call_u16) {
+    cpu->sp -= 2;
+    write16(mmu, cpu->sp, cpu->pc);
+    cpu->pc = imm;
+    return 6;
+}
+
+HANDLER(reti) {
+    cpu->pc = read16(mmu, &cpu->sp);
+    cpu->ime = true;
+    return 4;
+}
+
+HANDLER(ldh_mem_u8_a) {
+    gb15_mmu_write(mmu, (u16)0xFF00 + imm, cpu->a);
+    return 3;
+}
+
+HANDLER(ldh_mem_c_a) {
+    gb15_mmu_write(mmu, (u16)0xFF00 + (u16)cpu->c, cpu->a);
+    return 2;
+}
+
+static inline u16 sp_offset(GB15Cpu *cpu, u8 value) {
+    sync_flags(cpu);
+    set_c(cpu, ((cpu->sp & (u16)0xFF) + (u16)value) > (u16)0xFF);
+    set_h(cpu, ((cpu->sp & (u16)0xF) + ((u16)value & (u16)0xF)) > (u16)0xF);
+    set_n(cpu, false);
+    set_z(cpu, false);
+    return cpu->sp + (u16)signify8(value);
+}
+
+HANDLER(add_sp_s8) {
+    cpu->sp = sp_offset(cpu, (u8)imm);
+    return 4;
+}
+
+HANDLER(jp_hl) {
+    cpu->pc = cpu->hl;
+    return 1;
+}
+
+HANDLER(ld_mem_u16_a) {
+    gb15_mmu_write(mmu, imm, cpu->a);
+    return 4;
+}
+
+HANDLER(ldh_a_mem_u8) {
+    cpu->a = gb15_mmu_read(mmu, (u16)0xFF00 + imm);
+    return 3;
+}
+
+HANDLER(ldh_a_mem_c) {
+    cpu->a = gb15_mmu_read(mmu, (u16)0xFF00 + (u16)cpu->c);
+    return 2;
+}
+
+HANDLER(di) {
+    cpu->ime = false;
+    return 1;
+}
+
+HANDLER(ld_hl_sp_s8) {
+    cpu->hl = sp_offset(cpu, (u8)imm);
+    return 3;
+}
+
+HANDLER(ld_sp_hl) {
+    cpu->sp = cpu->hl;
+    return 2;
+}
+
+HANDLER(ld_a_mem_u16) {
+    cpu->a = gb15_mmu_read(mmu, imm);
+    return 4;
+}
+
+HANDLER(ei) {
+    cpu->ime = true;
+    return 1;
+}
+
+#endif /* _GB15_HANDLERS_H_ */
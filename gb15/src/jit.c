@@ -0,0 +1,1202 @@
+#define _DEFAULT_SOURCE
+
+#include <cpuid.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "jit.h"
+#include "util.h"
+
+/**
+ * Largest translation of a single op, slow paths and exit stubs included
+ */
+#define MAX_OP_BYTES 512
+
+/**
+ * Prologue, epilogue and the final exit of a block
+ */
+#define BLOCK_BYTES 256
+
+#define MAX_EXITS (GB15_BLOCK_MAX_OPS * 5 + 2)
+#define MAX_SLOW_PATHS (GB15_BLOCK_MAX_OPS * 2)
+
+#define CPU_FIELD(field) (s32)(offsetof(GB15State, cpu) + offsetof(GB15Cpu, field))
+#define MMU_FIELD(field) (s32)(offsetof(GB15State, mmu) + offsetof(GB15Mmu, field))
+#define SCHEDULER_FIELD(field) (s32)(offsetof(GB15State, scheduler) + offsetof(GB15Scheduler, field))
+#define IO_REGISTER(port) (MMU_FIELD(io) + (s32)(port))
+
+/**
+ * x86 8-bit register numbers. AH-BH cannot be encoded in an instruction with a REX prefix, so guest
+ * values only ever move through them with legacy encodings.
+ */
+#define AL 0
+#define CL 1
+#define DL 2
+#define BL 3
+#define AH 4
+#define CH 5
+#define DH 6
+#define BH 7
+
+/**
+ * Guest registers live in host registers for the whole block: A in al, BC/DE/HL in cx/dx/bx, the
+ * scheduler's cycles and next in r12/r13 and the state pointer in rbp. Flags live in edi in the
+ * layout lahf leaves them in, so x86 flags are captured with a mask rather than recomputed.
+ * ah, esi, r8 and r9 are scratch; memory values pass through ah.
+ */
+#define FLAG_Z 0x40
+#define FLAG_N 0x20
+#define FLAG_H 0x10
+#define FLAG_C 0x01
+
+/**
+ * Host register of each guest register in opcode order: b, c, d, e, h, l, (hl), a
+ */
+static const u8 HOST8[8] = { CH, CL, DH, DL, BH, BL, 0xFF, AL };
+
+/**
+ * Host register of bc, de and hl in opcode order. sp stays in GB15Cpu.
+ */
+static const u8 HOST16[3] = { CL, DL, BL };
+
+#define JMP 0x00
+#define JB 0x82
+#define JAE 0x83
+#define JZ 0x84
+#define JNZ 0x85
+
+typedef struct Exit {
+    /**
+     * rel32 field of the jump
+     */
+    u32 at;
+
+    /**
+     * Guest pc to leave with. Dynamic exits have already stored it.
+     */
+    u16 pc;
+    bool dynamic;
+
+} Exit;
+
+/**
+ * Page table miss of an inline access, called out of line so the hit path stays straight
+ */
+typedef struct SlowPath {
+    u32 at;
+    u32 resume;
+    bool write;
+
+} SlowPath;
+
+typedef struct Emitter {
+    u8 *code;
+    u32 at;
+
+    Exit exits[MAX_EXITS];
+    u32 num_exits;
+
+    SlowPath slow_paths[MAX_SLOW_PATHS];
+    u32 num_slow_paths;
+
+    /**
+     * First op of the block and where its code starts, for branches back to it
+     */
+    u16 start;
+    u32 loop;
+
+    /**
+     * Branches may go straight back to the start of a block that writes nothing, as it cannot
+     * have changed its own code, a bank or the pending interrupts
+     */
+    bool can_loop;
+
+} Emitter;
+
+static inline void emit8(Emitter *e, u8 value) {
+    e->code[e->at++] = value;
+}
+
+static inline void emit16(Emitter *e, u16 value) {
+    memcpy(e->code + e->at, &value, sizeof(value));
+    e->at += sizeof(value);
+}
+
+static inline void emit32(Emitter *e, u32 value) {
+    memcpy(e->code + e->at, &value, sizeof(value));
+    e->at += sizeof(value);
+}
+
+static inline void emit64(Emitter *e, u64 value) {
+    memcpy(e->code + e->at, &value, sizeof(value));
+    e->at += sizeof(value);
+}
+
+static inline void emit_bytes(Emitter *e, const u8 *bytes, u32 count) {
+    memcpy(e->code + e->at, bytes, count);
+    e->at += count;
+}
+
+#define EMIT(e, ...) emit_bytes(e, (const u8[]){ __VA_ARGS__ }, sizeof((const u8[]){ __VA_ARGS__ }))
+
+/**
+ * ModRM + disp32 for [rbp + disp]
+ */
+static inline void emit_rbp(Emitter *e, u8 reg, s32 disp) {
+    emit8(e, (u8)0x80 | (u8)((reg & 7) << 3) | (u8)0x05);
+    emit32(e, (u32)disp);
+}
+
+/**
+ * ModRM for a register-direct operand
+ */
+static inline void emit_reg(Emitter *e, u8 reg, u8 rm) {
+    emit8(e, (u8)0xC0 | (u8)((reg & 7) << 3) | (u8)(rm & 7));
+}
+
+static inline void patch(Emitter *e, u32 at, u32 target) {
+    u32 rel = (u32)((s32)target - (s32)(at + 4));
+    memcpy(e->code + at, &rel, sizeof(rel));
+}
+
+/**
+ * Jump, conditional when condition is not JMP, to a rel32 that is patched later
+ */
+static inline u32 emit_jump(Emitter *e, u8 condition) {
+    if (condition == JMP) {
+        emit8(e, 0xE9);
+    } else {
+        emit8(e, 0x0F);
+        emit8(e, condition);
+    }
+    u32 at = e->at;
+    emit32(e, 0);
+    return at;
+}
+
+/**
+ * Leave the block with pc set to the given address
+ */
+static inline void emit_exit(Emitter *e, u8 condition, u16 pc) {
+    Exit *exit = e->exits + e->num_exits++;
+    exit->at = emit_jump(e, condition);
+    exit->pc = pc;
+    exit->dynamic = false;
+}
+
+/**
+ * Leave the block with the pc already in GB15Cpu
+ */
+static inline void emit_exit_dynamic(Emitter *e, u8 condition) {
+    Exit *exit = e->exits + e->num_exits++;
+    exit->at = emit_jump(e, condition);
+    exit->pc = 0;
+    exit->dynamic = true;
+}
+
+static void emit_load_flags(Emitter *e) {
+    emit8(e, 0x89); // mov edi, esi
+    emit8(e, 0xF7);
+    EMIT(e, 0xD1, 0xEF); // shr edi, 1
+    EMIT(e, 0x83, 0xE7, 0x70); // and edi, Z | N | H
+    EMIT(e, 0xC1, 0xEE, 0x04); // shr esi, 4
+    EMIT(e, 0x83, 0xE6, FLAG_C); // and esi, C
+    EMIT(e, 0x09, 0xF7); // or edi, esi
+}
+
+/**
+ * Convert the flags in edi back to f in esi
+ */
+static void emit_flags_to_f(Emitter *e) {
+    EMIT(e, 0x89, 0xFE); // mov esi, edi
+    EMIT(e, 0x83, 0xE6, 0x70); // and esi, Z | N | H
+    EMIT(e, 0xD1, 0xE6); // shl esi, 1
+    EMIT(e, 0x41, 0x89, 0xF8); // mov r8d, edi
+    EMIT(e, 0x41, 0x83, 0xE0, FLAG_C); // and r8d, C
+    EMIT(e, 0x41, 0xC1, 0xE0, 0x04); // shl r8d, 4
+    EMIT(e, 0x44, 0x09, 0xC6); // or esi, r8d
+}
+
+static void emit_load_cycles(Emitter *e) {
+    EMIT(e, 0x4C, 0x8B); // mov r12, [cycles]
+    emit_rbp(e, 4, SCHEDULER_FIELD(cycles));
+    EMIT(e, 0x4C, 0x8B); // mov r13, [next]
+    emit_rbp(e, 5, SCHEDULER_FIELD(next));
+}
+
+/**
+ * Move the guest registers from GB15State into host registers. Flags must be synced.
+ */
+static void emit_load(Emitter *e) {
+    emit8(e, 0x8A); // mov al, [a]
+    emit_rbp(e, AL, CPU_FIELD(a));
+    EMIT(e, 0x66, 0x8B); // mov cx, [bc]
+    emit_rbp(e, CL, CPU_FIELD(bc));
+    EMIT(e, 0x66, 0x8B); // mov dx, [de]
+    emit_rbp(e, DL, CPU_FIELD(de));
+    EMIT(e, 0x66, 0x8B); // mov bx, [hl]
+    emit_rbp(e, BL, CPU_FIELD(hl));
+    EMIT(e, 0x0F, 0xB6); // movzx esi, byte [f]
+    emit_rbp(e, 6, CPU_FIELD(f));
+    emit_load_flags(e);
+    emit_load_cycles(e);
+}
+
+/**
+ * Write the guest registers and cycles back to GB15State
+ */
+static void emit_store(Emitter *e) {
+    emit8(e, 0x88); // mov [a], al
+    emit_rbp(e, AL, CPU_FIELD(a));
+    EMIT(e, 0x66, 0x89); // mov [bc], cx
+    emit_rbp(e, CL, CPU_FIELD(bc));
+    EMIT(e, 0x66, 0x89); // mov [de], dx
+    emit_rbp(e, DL, CPU_FIELD(de));
+    EMIT(e, 0x66, 0x89); // mov [hl], bx
+    emit_rbp(e, BL, CPU_FIELD(hl));
+    emit_flags_to_f(e);
+    EMIT(e, 0x40, 0x88); // mov [f], sil
+    emit_rbp(e, 6, CPU_FIELD(f));
+    emit8(e, 0xC6); // mov byte [flags_op], GB15_FLAGS_NONE
+    emit_rbp(e, 0, CPU_FIELD(flags_op));
+    emit8(e, (u8)GB15_FLAGS_NONE);
+    EMIT(e, 0x4C, 0x89); // mov [cycles], r12
+    emit_rbp(e, 4, SCHEDULER_FIELD(cycles));
+}
+
+/**
+ * Capture Z/H/C from the x86 flags of the last instruction into edi: bits in mask are taken from
+ * lahf, bits in keep are kept and bits in set are set
+ */
+static void emit_flags(Emitter *e, u8 mask, u8 keep, u8 set) {
+    emit8(e, 0x9F); // lahf
+    if (keep == 0) {
+        EMIT(e, 0x0F, 0xB6, 0xFC); // movzx edi, ah
+        EMIT(e, 0x83, 0xE7, mask); // and edi, mask
+    } else {
+        EMIT(e, 0x0F, 0xB6, 0xF4); // movzx esi, ah
+        EMIT(e, 0x83, 0xE6, mask); // and esi, mask
+        EMIT(e, 0x83, 0xE7, keep); // and edi, keep
+        EMIT(e, 0x09, 0xF7); // or edi, esi
+    }
+    if (set != 0) {
+        EMIT(e, 0x83, 0xCF, set); // or edi, set
+    }
+}
+
+/**
+ * Load the guest carry into CF for adc, sbc and the rotates through carry
+ */
+static void emit_carry_in(Emitter *e) {
+    EMIT(e, 0x0F, 0xBA, 0xE7, 0x00); // bt edi, 0
+}
+
+/**
+ * Read the byte at the address in esi into ah, through the page table when the page is mapped
+ */
+static void emit_access(Emitter *e, bool write) {
+    EMIT(e, 0x41, 0x89, 0xF0); // mov r8d, esi
+    EMIT(e, 0x41, 0xC1, 0xE8, 0x08); // shr r8d, 8
+    EMIT(e, 0x4E, 0x8B, 0x84, 0xC5); // mov r8, [rbp + r8 * 8 + pages]
+    emit32(e, (u32)(write? MMU_FIELD(write_pages) : MMU_FIELD(read_pages)));
+    EMIT(e, 0x4D, 0x85, 0xC0); // test r8, r8
+    SlowPath *slow = e->slow_paths + e->num_slow_paths++;
+    slow->at = emit_jump(e, JZ);
+    slow->write = write;
+    EMIT(e, 0x81, 0xE6); // and esi, 0xFF
+    emit32(e, 0xFF);
+    EMIT(e, 0x4C, 0x01, 0xC6); // add rsi, r8
+    if (write) {
+        EMIT(e, 0x88, 0x26); // mov [rsi], ah
+    } else {
+        EMIT(e, 0x8A, 0x26); // mov ah, [rsi]
+    }
+    slow->resume = e->at;
+}
+
+static inline void emit_read(Emitter *e) {
+    emit_access(e, false);
+}
+
+/**
+ * Write ah to the address in esi
+ */
+static inline void emit_write(Emitter *e) {
+    emit_access(e, true);
+}
+
+/**
+ * Call gb15_mmu_read_slow or gb15_mmu_write_slow with the address in esi. They may run the
+ * scheduler's cycles forward (HDMA) or reschedule, and read the cycles (DIV), so both go through
+ * memory.
+ */
+static void emit_slow_path(Emitter *e, const SlowPath *slow) {
+    patch(e, slow->at, e->at);
+    EMIT(e, 0x4C, 0x89); // mov [cycles], r12
+    emit_rbp(e, 4, SCHEDULER_FIELD(cycles));
+    EMIT(e, 0x89, 0x3C, 0x24); // mov [rsp], edi
+    emit8(e, 0x88); // mov [a], al
+    emit_rbp(e, AL, CPU_FIELD(a));
+    EMIT(e, 0x66, 0x89); // mov [bc], cx
+    emit_rbp(e, CL, CPU_FIELD(bc));
+    EMIT(e, 0x66, 0x89); // mov [de], dx
+    emit_rbp(e, DL, CPU_FIELD(de));
+    if (slow->write) {
+        EMIT(e, 0x0F, 0xB6, 0xD4); // movzx edx, ah
+    }
+    EMIT(e, 0x48, 0x8D); // lea rdi, [mmu]
+    emit_rbp(e, 7, (s32)offsetof(GB15State, mmu));
+    EMIT(e, 0x48, 0xB8); // mov rax, slow
+    emit64(e, slow->write? (u64)(uz)gb15_mmu_write_slow : (u64)(uz)gb15_mmu_read_slow);
+    EMIT(e, 0xFF, 0xD0); // call rax
+    if (!slow->write) {
+        EMIT(e, 0x88, 0xC4); // mov ah, al
+    }
+    emit8(e, 0x8A); // mov al, [a]
+    emit_rbp(e, AL, CPU_FIELD(a));
+    EMIT(e, 0x66, 0x8B); // mov cx, [bc]
+    emit_rbp(e, CL, CPU_FIELD(bc));
+    EMIT(e, 0x66, 0x8B); // mov dx, [de]
+    emit_rbp(e, DL, CPU_FIELD(de));
+    EMIT(e, 0x8B, 0x3C, 0x24); // mov edi, [rsp]
+    emit_load_cycles(e);
+    emit8(e, 0xE9); // jmp resume
+    emit32(e, 0);
+    patch(e, e->at - 4, slow->resume);
+}
+
+static void emit_address_hl(Emitter *e) {
+    EMIT(e, 0x0F, 0xB7, 0xF3); // movzx esi, bx
+}
+
+static void emit_address_imm(Emitter *e, u16 address) {
+    emit8(e, 0xBE); // mov esi, address
+    emit32(e, address);
+}
+
+/**
+ * esi = sp + offset, wrapped to 16 bits
+ */
+static void emit_address_sp(Emitter *e, u8 offset) {
+    EMIT(e, 0x0F, 0xB7); // movzx esi, word [sp]
+    emit_rbp(e, 6, CPU_FIELD(sp));
+    if (offset != 0) {
+        EMIT(e, 0x83, 0xC6, offset); // add esi, offset
+        EMIT(e, 0x0F, 0xB7, 0xF6); // movzx esi, si
+    }
+}
+
+static void emit_add_cycles(Emitter *e, u32 cycles) {
+    EMIT(e, 0x49, 0x83, 0xC4, (u8)cycles); // add r12, cycles
+}
+
+static void emit_check_cycles(Emitter *e, u16 pc) {
+    EMIT(e, 0x4D, 0x39, 0xEC); // cmp r12, r13
+    emit_exit(e, JAE, pc);
+}
+
+/**
+ * Leave when the op wrote to code, started a DMA or made an interrupt pending
+ */
+static void emit_check_writes(Emitter *e, u16 pc) {
+    emit8(e, 0x80); // cmp byte [code_written], 0
+    emit_rbp(e, 7, MMU_FIELD(code_written));
+    emit8(e, 0x00);
+    emit_exit(e, JNZ, pc);
+    emit8(e, 0x80); // cmp byte [ime], 0
+    emit_rbp(e, 7, CPU_FIELD(ime));
+    emit8(e, 0x00);
+    emit8(e, 0x74); // je over the pending interrupt test
+    u32 skip = e->at;
+    emit8(e, 0);
+    EMIT(e, 0x0F, 0xB6); // movzx esi, byte [if]
+    emit_rbp(e, 6, IO_REGISTER(GB15_IO_IF));
+    EMIT(e, 0x40, 0x22); // and sil, [ie]
+    emit_rbp(e, 6, IO_REGISTER(GB15_IO_IE));
+    emit_exit(e, JNZ, pc);
+    e->code[skip] = (u8)(e->at - (skip + 1));
+}
+
+/**
+ * Taken branch to a known address
+ */
+static void emit_branch(Emitter *e, u16 target, u32 cycles) {
+    emit_add_cycles(e, cycles);
+    if (e->can_loop && target == e->start) {
+        EMIT(e, 0x4D, 0x39, 0xEC); // cmp r12, r13
+        emit8(e, 0x0F); // jb loop
+        emit8(e, JB);
+        emit32(e, 0);
+        patch(e, e->at - 4, e->loop);
+    }
+    emit_exit(e, JMP, target);
+}
+
+/**
+ * Skip the taken path of a conditional op (jr/jp/call/ret cc) when its condition does not hold.
+ * Returns the jump to patch past the taken path.
+ */
+static u32 emit_condition(Emitter *e, u16 index) {
+    u8 cc = (u8)((index >> 3) & 0x03);
+    EMIT(e, 0x40, 0xF6, 0xC7, cc < 2? FLAG_Z : FLAG_C); // test dil, flag
+    return emit_jump(e, (cc & 1)? JZ : JNZ);
+}
+
+/**
+ * Push a 16-bit value whose bytes are put in ah by the callbacks
+ */
+static void emit_push(Emitter *e, void (*high)(Emitter *, u16), void (*low)(Emitter *, u16), u16 value) {
+    EMIT(e, 0x66, 0x83); // sub word [sp], 2
+    emit_rbp(e, 5, CPU_FIELD(sp));
+    emit8(e, 0x02);
+    // Bytes first, f is converted in esi
+    low(e, value);
+    emit_address_sp(e, 0);
+    emit_write(e);
+    high(e, value);
+    emit_address_sp(e, 1);
+    emit_write(e);
+}
+
+static void push_imm_low(Emitter *e, u16 value) {
+    EMIT(e, 0xB4, (u8)value); // mov ah, low
+}
+
+static void push_imm_high(Emitter *e, u16 value) {
+    EMIT(e, 0xB4, (u8)(value >> 8)); // mov ah, high
+}
+
+/**
+ * Low byte of push bc/de/hl/af, the pair given as its opcode bits
+ */
+static void push_reg_low(Emitter *e, u16 pair) {
+    if (pair == 3) {
+        // f goes through the scratch slot, sil has no legacy encoding next to ah
+        emit_flags_to_f(e);
+        EMIT(e, 0x40, 0x88, 0x74, 0x24, 0x04); // mov [rsp + 4], sil
+        EMIT(e, 0x8A, 0x64, 0x24, 0x04); // mov ah, [rsp + 4]
+        return;
+    }
+    emit8(e, 0x88); // mov ah, low
+    emit_reg(e, HOST16[pair], AH);
+}
+
+static void push_reg_high(Emitter *e, u16 pair) {
+    emit8(e, 0x88); // mov ah, high
+    emit_reg(e, pair == 3? AL : HOST16[pair] + 4, AH);
+}
+
+/**
+ * Pop into pc, leaving with the address read
+ */
+static void emit_return(Emitter *e, u32 cycles) {
+    emit_address_sp(e, 0);
+    emit_read(e);
+    emit8(e, 0x88); // mov [pc], ah
+    emit_rbp(e, AH, CPU_FIELD(pc));
+    emit_address_sp(e, 1);
+    emit_read(e);
+    emit8(e, 0x88); // mov [pc + 1], ah
+    emit_rbp(e, AH, CPU_FIELD(pc) + 1);
+    EMIT(e, 0x66, 0x83); // add word [sp], 2
+    emit_rbp(e, 0, CPU_FIELD(sp));
+    emit8(e, 0x02);
+    emit_add_cycles(e, cycles);
+    emit_exit_dynamic(e, JMP);
+}
+
+static void run_handler(GB15State *state, GB15Handler handler, u16 imm) {
+    state->scheduler.cycles += handler(&state->cpu, &state->mmu, imm);
+    gb15_cpu_sync_flags(&state->cpu);
+}
+
+/**
+ * Ops too rare to be worth translating call their handler with the registers in GB15State
+ */
+static bool emit_handler(Emitter *e, const GB15BlockOp *op) {
+    EMIT(e, 0x66, 0xC7); // mov word [pc], next
+    emit_rbp(e, 0, CPU_FIELD(pc));
+    emit16(e, op->next);
+    emit_store(e);
+    EMIT(e, 0x48, 0x89, 0xEF); // mov rdi, rbp
+    EMIT(e, 0x48, 0xBE); // mov rsi, handler
+    emit64(e, (u64)(uz)gb15_cpu_handler(op->index));
+    emit8(e, 0xBA); // mov edx, imm
+    emit32(e, op->imm);
+    EMIT(e, 0x48, 0xB8); // mov rax, run_handler
+    emit64(e, (u64)(uz)run_handler);
+    EMIT(e, 0xFF, 0xD0); // call rax
+    emit_load(e);
+    if (gb15_op_effects(op->index) & GB15_OP_BRANCHES) {
+        EMIT(e, 0x66, 0x81); // cmp word [pc], next
+        emit_rbp(e, 7, CPU_FIELD(pc));
+        emit16(e, op->next);
+        emit_exit_dynamic(e, JNZ);
+    }
+    if (gb15_op_ends_block(op->index)) {
+        // halt and stop leave pc where the interpreter would resume
+        emit_exit_dynamic(e, JMP);
+        return false;
+    }
+    emit_check_cycles(e, op->next);
+    return true;
+}
+
+/**
+ * add, adc, sub, sbc, and, xor, or, cp with a register operand, or an immediate when reg is 0xFF
+ */
+static void emit_alu(Emitter *e, u8 alu, u8 reg, u8 imm) {
+    static const u8 OPCODES[8] = { 0x00, 0x10, 0x28, 0x18, 0x20, 0x30, 0x08, 0x38 };
+    if (alu == 1 || alu == 3) {
+        emit_carry_in(e);
+    }
+    if (reg == 0xFF) {
+        emit8(e, OPCODES[alu] + 4); // op al, imm
+        emit8(e, imm);
+    } else {
+        emit8(e, OPCODES[alu]); // op al, reg
+        emit_reg(e, reg, AL);
+    }
+    switch (alu) {
+        case 0:
+        case 1:
+            emit_flags(e, FLAG_Z | FLAG_H | FLAG_C, 0, 0);
+            break;
+        case 2:
+        case 3:
+        case 7:
+            emit_flags(e, FLAG_Z | FLAG_H | FLAG_C, 0, FLAG_N);
+            break;
+        case 4:
+            emit_flags(e, FLAG_Z, 0, FLAG_H);
+            break;
+        default:
+            emit_flags(e, FLAG_Z, 0, 0);
+            break;
+    }
+}
+
+/**
+ * CB-prefixed ops on a register
+ */
+static void emit_cb(Emitter *e, u8 cb) {
+    // rol, ror, rcl, rcr, shl, sar, (swap), shr
+    static const u8 SHIFTS[8] = { 0, 1, 2, 3, 4, 7, 0, 5 };
+    u8 reg = HOST8[cb & 0x07];
+    u8 n = (u8)((cb >> 3) & 0x07);
+    switch (cb >> 6) {
+        case 0:
+            if (n == 2 || n == 3) {
+                emit_carry_in(e);
+            }
+            if (n == 6) {
+                emit8(e, 0xC0); // rol reg, 4
+                emit_reg(e, 0, reg);
+                emit8(e, 0x04);
+                emit8(e, 0x84); // test reg, reg
+                emit_reg(e, reg, reg);
+                emit_flags(e, FLAG_Z, 0, 0);
+                break;
+            }
+            emit8(e, 0xD0); // shift reg, 1
+            emit_reg(e, SHIFTS[n], reg);
+            if (n >= 4) {
+                emit_flags(e, FLAG_Z | FLAG_C, 0, 0);
+                break;
+            }
+            // Rotates leave ZF alone
+            EMIT(e, 0xBF, 0x00, 0x00, 0x00, 0x00); // mov edi, 0
+            EMIT(e, 0x11, 0xFF); // adc edi, edi
+            emit8(e, 0x84); // test reg, reg
+            emit_reg(e, reg, reg);
+            emit_flags(e, FLAG_Z, FLAG_C, 0);
+            break;
+        case 1:
+            emit8(e, 0xF6); // test reg, bit
+            emit_reg(e, 0, reg);
+            emit8(e, (u8)(1 << n));
+            emit_flags(e, FLAG_Z, FLAG_C, FLAG_H);
+            break;
+        case 2:
+            emit8(e, 0x80); // and reg, ~bit
+            emit_reg(e, 4, reg);
+            emit8(e, (u8)~(1 << n));
+            break;
+        default:
+            emit8(e, 0x80); // or reg, bit
+            emit_reg(e, 1, reg);
+            emit8(e, (u8)(1 << n));
+            break;
+    }
+}
+
+/**
+ * Translate one op, its cycles included. Returns false when it always leaves the block.
+ */
+static bool emit_op(Emitter *e, const GB15BlockOp *op) {
+    u16 index = op->index;
+    u32 cycles;
+    if (index >= 0x100) {
+        if ((index & 0x07) == 6) {
+            return emit_handler(e, op);
+        }
+        emit_cb(e, (u8)index);
+        emit_add_cycles(e, 2);
+        emit_check_cycles(e, op->next);
+        return true;
+    }
+
+    u8 r = (u8)((index >> 3) & 0x07);
+    u8 pair = (u8)((index >> 4) & 0x03);
+    switch (index) {
+        case 0x01: // ld rr, u16
+        case 0x11:
+        case 0x21:
+            EMIT(e, 0x66, 0xB8 + HOST16[pair]); // mov rr, imm
+            emit16(e, op->imm);
+            cycles = 3;
+            break;
+        case 0x31:
+            EMIT(e, 0x66, 0xC7); // mov word [sp], imm
+            emit_rbp(e, 0, CPU_FIELD(sp));
+            emit16(e, op->imm);
+            cycles = 3;
+            break;
+        case 0x02: // ld (bc), a, ld (de), a
+        case 0x12:
+            EMIT(e, 0x0F, 0xB7, 0xF0 + HOST16[pair]); // movzx esi, rr
+            EMIT(e, 0x88, 0xC4); // mov ah, al
+            emit_write(e);
+            cycles = 2;
+            break;
+        case 0x0A: // ld a, (bc), ld a, (de)
+        case 0x1A:
+            EMIT(e, 0x0F, 0xB7, 0xF0 + HOST16[pair]); // movzx esi, rr
+            emit_read(e);
+            EMIT(e, 0x88, 0xE0); // mov al, ah
+            cycles = 2;
+            break;
+        case 0x03: // inc rr, dec rr
+        case 0x13:
+        case 0x23:
+        case 0x0B:
+        case 0x1B:
+        case 0x2B:
+            EMIT(e, 0x66, 0xFF); // inc/dec rr
+            emit_reg(e, (index & 0x08)? 1 : 0, HOST16[pair]);
+            cycles = 2;
+            break;
+        case 0x33:
+        case 0x3B:
+            EMIT(e, 0x66, 0xFF); // inc/dec word [sp]
+            emit_rbp(e, (index & 0x08)? 1 : 0, CPU_FIELD(sp));
+            cycles = 2;
+            break;
+        case 0x34: // inc (hl), dec (hl)
+        case 0x35:
+            emit_address_hl(e);
+            emit_read(e);
+            EMIT(e, 0xFE, index == 0x34? 0xC4 : 0xCC); // inc/dec ah
+            EMIT(e, 0x41, 0x89, 0xC1); // mov r9d, eax
+            emit_flags(e, FLAG_Z | FLAG_H, FLAG_C, index == 0x34? 0 : FLAG_N);
+            EMIT(e, 0x44, 0x89, 0xC8); // mov eax, r9d
+            emit_address_hl(e);
+            emit_write(e);
+            cycles = 3;
+            break;
+        case 0x04 ... 0x05: // inc r, dec r
+        case 0x0C ... 0x0D:
+        case 0x14 ... 0x15:
+        case 0x1C ... 0x1D:
+        case 0x24 ... 0x25:
+        case 0x2C ... 0x2D:
+        case 0x3C ... 0x3D:
+            emit8(e, 0xFE); // inc/dec r
+            emit_reg(e, (index & 0x01)? 1 : 0, HOST8[r]);
+            emit_flags(e, FLAG_Z | FLAG_H, FLAG_C, (index & 0x01)? FLAG_N : 0);
+            cycles = 1;
+            break;
+        case 0x36: // ld (hl), u8
+            emit_address_hl(e);
+            EMIT(e, 0xB4, (u8)op->imm); // mov ah, imm
+            emit_write(e);
+            cycles = 3;
+            break;
+        case 0x06: // ld r, u8
+        case 0x0E:
+        case 0x16:
+        case 0x1E:
+        case 0x26:
+        case 0x2E:
+        case 0x3E:
+            EMIT(e, 0xB0 + HOST8[r], (u8)op->imm); // mov r, imm
+            cycles = 2;
+            break;
+        case 0x07: // rlca, rrca, rla, rra
+        case 0x0F:
+        case 0x17:
+        case 0x1F:
+            if (index >= 0x17) {
+                emit_carry_in(e);
+            }
+            emit8(e, 0xD0); // rol/ror/rcl/rcr al, 1
+            emit_reg(e, r, AL);
+            emit_flags(e, FLAG_C, 0, 0);
+            cycles = 1;
+            break;
+        case 0x08: // ld (u16), sp
+            emit_address_imm(e, op->imm);
+            emit8(e, 0x8A); // mov ah, [sp]
+            emit_rbp(e, AH, CPU_FIELD(sp));
+            emit_write(e);
+            emit_address_imm(e, (u16)(op->imm + 1));
+            emit8(e, 0x8A); // mov ah, [sp + 1]
+            emit_rbp(e, AH, CPU_FIELD(sp) + 1);
+            emit_write(e);
+            cycles = 5;
+            break;
+        case 0x09: // add hl, rr
+        case 0x19:
+        case 0x29:
+        case 0x39:
+            if (pair == 3) {
+                EMIT(e, 0x44, 0x0F, 0xB7); // movzx r8d, word [sp]
+                emit_rbp(e, 0, CPU_FIELD(sp));
+            } else {
+                EMIT(e, 0x44, 0x0F, 0xB7, 0xC0 + HOST16[pair]); // movzx r8d, rr
+            }
+            // H is the carry out of bit 11
+            EMIT(e, 0x45, 0x89, 0xC1); // mov r9d, r8d
+            EMIT(e, 0x41, 0x81, 0xE1); // and r9d, 0xFFF
+            emit32(e, 0xFFF);
+            emit_address_hl(e);
+            EMIT(e, 0x81, 0xE6); // and esi, 0xFFF
+            emit32(e, 0xFFF);
+            EMIT(e, 0x44, 0x01, 0xCE); // add esi, r9d
+            EMIT(e, 0xC1, 0xEE, 0x08); // shr esi, 8
+            EMIT(e, 0x83, 0xE6, FLAG_H); // and esi, H
+            EMIT(e, 0x83, 0xE7, FLAG_Z); // and edi, Z
+            EMIT(e, 0x09, 0xF7); // or edi, esi
+            EMIT(e, 0x66, 0x44, 0x01, 0xC3); // add bx, r8w
+            EMIT(e, 0x83, 0xD7, 0x00); // adc edi, 0
+            cycles = 2;
+            break;
+        case 0x18: // jr s8
+            emit_branch(e, (u16)(op->next + signify8((u8)op->imm)), 3);
+            return false;
+        case 0x20: // jr cc, s8
+        case 0x28:
+        case 0x30:
+        case 0x38: {
+            u32 skip = emit_condition(e, index);
+            emit_branch(e, (u16)(op->next + signify8((u8)op->imm)), 3);
+            patch(e, skip, e->at);
+            cycles = 2;
+            break;
+        }
+        case 0x22: // ldi/ldd (hl), a
+        case 0x32:
+            emit_address_hl(e);
+            EMIT(e, 0x88, 0xC4); // mov ah, al
+            emit_write(e);
+            EMIT(e, 0x66, 0xFF, index == 0x22? 0xC3 : 0xCB); // inc/dec bx
+            cycles = 2;
+            break;
+        case 0x2A: // ldi/ldd a, (hl)
+        case 0x3A:
+            emit_address_hl(e);
+            emit_read(e);
+            EMIT(e, 0x88, 0xE0); // mov al, ah
+            EMIT(e, 0x66, 0xFF, index == 0x2A? 0xC3 : 0xCB); // inc/dec bx
+            cycles = 2;
+            break;
+        case 0x2F: // cpl
+            EMIT(e, 0xF6, 0xD0); // not al
+            EMIT(e, 0x83, 0xCF, FLAG_N | FLAG_H); // or edi, N | H
+            cycles = 1;
+            break;
+        case 0x37: // scf
+            EMIT(e, 0x83, 0xE7, FLAG_Z); // and edi, Z
+            EMIT(e, 0x83, 0xCF, FLAG_C); // or edi, C
+            cycles = 1;
+            break;
+        case 0x3F: // ccf
+            EMIT(e, 0x83, 0xE7, FLAG_Z | FLAG_C); // and edi, Z | C
+            EMIT(e, 0x83, 0xF7, FLAG_C); // xor edi, C
+            cycles = 1;
+            break;
+        case 0x40 ... 0x75: // ld r, r
+        case 0x77 ... 0x7F: {
+            u8 src = (u8)(index & 0x07);
+            if (src == 6) {
+                emit_address_hl(e);
+                emit_read(e);
+                emit8(e, 0x88); // mov r, ah
+                emit_reg(e, AH, HOST8[r]);
+                cycles = 2;
+            } else if (r == 6) {
+                emit_address_hl(e);
+                emit8(e, 0x88); // mov ah, r
+                emit_reg(e, HOST8[src], AH);
+                emit_write(e);
+                cycles = 2;
+            } else {
+                if (r != src) {
+                    emit8(e, 0x88); // mov r, r
+                    emit_reg(e, HOST8[src], HOST8[r]);
+                }
+                cycles = 1;
+            }
+            break;
+        }
+        case 0x80 ... 0xBF: { // alu a, r
+            u8 src = (u8)(index & 0x07);
+            if (src == 6) {
+                emit_address_hl(e);
+                emit_read(e);
+                emit_alu(e, r, AH, 0);
+                cycles = 2;
+            } else {
+                emit_alu(e, r, HOST8[src], 0);
+                cycles = 1;
+            }
+            break;
+        }
+        case 0xC6: // alu a, u8
+        case 0xCE:
+        case 0xD6:
+        case 0xDE:
+        case 0xE6:
+        case 0xEE:
+        case 0xF6:
+        case 0xFE:
+            emit_alu(e, r, 0xFF, (u8)op->imm);
+            cycles = 2;
+            break;
+        case 0xC0: // ret cc
+        case 0xC8:
+        case 0xD0:
+        case 0xD8: {
+            u32 skip = emit_condition(e, index);
+            emit_return(e, 5);
+            patch(e, skip, e->at);
+            cycles = 2;
+            break;
+        }
+        case 0xC1: // pop rr
+        case 0xD1:
+        case 0xE1:
+        case 0xF1:
+            emit_address_sp(e, 0);
+            emit_read(e);
+            if (pair == 3) {
+                EMIT(e, 0x0F, 0xB6, 0xF4); // movzx esi, ah
+                emit_load_flags(e);
+            } else {
+                emit8(e, 0x88); // mov low, ah
+                emit_reg(e, AH, HOST16[pair]);
+            }
+            emit_address_sp(e, 1);
+            emit_read(e);
+            emit8(e, 0x88); // mov high, ah
+            emit_reg(e, AH, pair == 3? AL : HOST16[pair] + 4);
+            EMIT(e, 0x66, 0x83); // add word [sp], 2
+            emit_rbp(e, 0, CPU_FIELD(sp));
+            emit8(e, 0x02);
+            cycles = 3;
+            break;
+        case 0xC5: // push rr
+        case 0xD5:
+        case 0xE5:
+        case 0xF5:
+            emit_push(e, push_reg_high, push_reg_low, pair);
+            cycles = 4;
+            break;
+        case 0xC2: // jp cc, u16
+        case 0xCA:
+        case 0xD2:
+        case 0xDA: {
+            u32 skip = emit_condition(e, index);
+            emit_branch(e, op->imm, 4);
+            patch(e, skip, e->at);
+            cycles = 3;
+            break;
+        }
+        case 0xC3: // jp u16
+            emit_branch(e, op->imm, 4);
+            return false;
+        case 0xC4: // call cc, u16
+        case 0xCC:
+        case 0xD4:
+        case 0xDC: {
+            u32 skip = emit_condition(e, index);
+            emit_push(e, push_imm_high, push_imm_low, op->next);
+            emit_add_cycles(e, 6);
+            emit_exit(e, JMP, op->imm);
+            patch(e, skip, e->at);
+            cycles = 3;
+            break;
+        }
+        case 0xCD: // call u16
+            emit_push(e, push_imm_high, push_imm_low, op->next);
+            emit_add_cycles(e, 6);
+            emit_exit(e, JMP, op->imm);
+            return false;
+        case 0xC7: // rst
+        case 0xCF:
+        case 0xD7:
+        case 0xDF:
+        case 0xE7:
+        case 0xEF:
+        case 0xF7:
+        case 0xFF:
+            emit_push(e, push_imm_high, push_imm_low, op->next);
+            emit_add_cycles(e, 4);
+            emit_exit(e, JMP, (u16)(index & 0x38));
+            return false;
+        case 0xD9: // reti
+            emit8(e, 0xC6); // mov byte [ime], 1
+            emit_rbp(e, 0, CPU_FIELD(ime));
+            emit8(e, 0x01);
+            // fallthrough
+        case 0xC9: // ret
+            emit_return(e, 4);
+            return false;
+        case 0xE0: // ldh (u8), a
+        case 0xEA: // ld (u16), a
+            emit_address_imm(e, index == 0xE0? (u16)(0xFF00 + op->imm) : op->imm);
+            EMIT(e, 0x88, 0xC4); // mov ah, al
+            emit_write(e);
+            cycles = index == 0xE0? 3 : 4;
+            break;
+        case 0xF0: // ldh a, (u8)
+        case 0xFA: // ld a, (u16)
+            emit_address_imm(e, index == 0xF0? (u16)(0xFF00 + op->imm) : op->imm);
+            emit_read(e);
+            EMIT(e, 0x88, 0xE0); // mov al, ah
+            cycles = index == 0xF0? 3 : 4;
+            break;
+        case 0xE2: // ldh (c), a
+        case 0xF2: // ldh a, (c)
+            EMIT(e, 0x0F, 0xB6, 0xF1); // movzx esi, cl
+            EMIT(e, 0x81, 0xCE); // or esi, 0xFF00
+            emit32(e, 0xFF00);
+            if (index == 0xE2) {
+                EMIT(e, 0x88, 0xC4); // mov ah, al
+                emit_write(e);
+            } else {
+                emit_read(e);
+                EMIT(e, 0x88, 0xE0); // mov al, ah
+            }
+            cycles = 2;
+            break;
+        case 0xE9: // jp hl
+            EMIT(e, 0x66, 0x89); // mov [pc], bx
+            emit_rbp(e, BL, CPU_FIELD(pc));
+            emit_add_cycles(e, 1);
+            emit_exit_dynamic(e, JMP);
+            return false;
+        case 0xF9: // ld sp, hl
+            EMIT(e, 0x66, 0x89); // mov [sp], bx
+            emit_rbp(e, BL, CPU_FIELD(sp));
+            cycles = 2;
+            break;
+        case 0xF3: // di, ei
+        case 0xFB:
+            emit8(e, 0xC6); // mov byte [ime], 0/1
+            emit_rbp(e, 0, CPU_FIELD(ime));
+            emit8(e, (u8)(index == 0xFB));
+            cycles = 1;
+            break;
+        case 0x00: // nop and the invalid opcodes, which run as nop
+        case 0xD3:
+        case 0xDB:
+        case 0xDD:
+        case 0xE3:
+        case 0xE4:
+        case 0xEB:
+        case 0xEC:
+        case 0xED:
+        case 0xF4:
+        case 0xFC:
+        case 0xFD:
+            cycles = 1;
+            break;
+        default: // stop, daa, halt, add sp, s8, ld hl, sp + s8
+            return emit_handler(e, op);
+    }
+    emit_add_cycles(e, cycles);
+    emit_check_cycles(e, op->next);
+    return true;
+}
+
+void gb15_jit_init(GB15BlockCache *cache) {
+    cache->code_used = 0;
+    if (cache->code != NULL) {
+        return;
+    }
+    // Flags are captured with lahf, which early x86-64 CPUs lack in long mode
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) || (ecx & 1) == 0) {
+        cache->code = NULL;
+        return;
+    }
+    // Writable until a block is written, then executable, never both
+    void *code = mmap(NULL, GB15_JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    cache->code = code == MAP_FAILED? NULL : code;
+}
+
+void gb15_jit_release(GB15BlockCache *cache) {
+    if (cache->code != NULL) {
+        munmap(cache->code, GB15_JIT_CODE_SIZE);
+        cache->code = NULL;
+    }
+}
+
+/**
+ * Drop every translation so that blocks run in the interpreter until they are hot again
+ */
+static void flush(GB15BlockCache *cache) {
+    for (u32 i = 0; i < GB15_BLOCK_CACHE_SIZE; i++) {
+        GB15Block *other = cache->blocks + i;
+        u8 *native = (u8 *)(uz)other->native;
+        if (native >= cache->code && native < cache->code + GB15_JIT_CODE_SIZE) {
+            other->hits = 0;
+            other->native = NULL;
+        }
+    }
+    cache->code_used = 0;
+}
+
+/**
+ * Change the protection of the pages holding [from, to) of the code buffer. Pages may be shared
+ * with earlier blocks, which is fine as none of them runs while a block is being translated.
+ */
+static bool protect(GB15BlockCache *cache, u32 from, u32 to, int prot) {
+    uz page = (uz)sysconf(_SC_PAGESIZE);
+    uz start = (uz)from & ~(page - 1);
+    uz end = ((uz)to + page - 1) & ~(page - 1);
+    if (end > GB15_JIT_CODE_SIZE) {
+        end = GB15_JIT_CODE_SIZE;
+    }
+    return mprotect(cache->code + start, end - start, prot) == 0;
+}
+
+bool gb15_jit_compile(GB15BlockCache *cache, GB15Block *block) {
+    if (cache->code == NULL) {
+        return false;
+    }
+    u32 size = block->length * MAX_OP_BYTES + BLOCK_BYTES;
+    if (cache->code_used + size > GB15_JIT_CODE_SIZE) {
+        // The block that filled the buffer is translated right away, as its hit count would
+        // never reach the threshold again
+        flush(cache);
+    }
+    if (!protect(cache, cache->code_used, cache->code_used + size, PROT_READ | PROT_WRITE)) {
+        // Without writable pages nothing more can be translated, so the interpreter takes over
+        flush(cache);
+        gb15_jit_release(cache);
+        return false;
+    }
+
+    Emitter e;
+    e.code = cache->code + cache->code_used;
+    e.at = 0;
+    e.num_exits = 0;
+    e.num_slow_paths = 0;
+    e.start = block->ops[0].pc;
+    e.can_loop = true;
+    for (u32 i = 0; i < block->length; i++) {
+        if (gb15_op_effects(block->ops[i].index) & GB15_OP_WRITES) {
+            e.can_loop = false;
+        }
+    }
+
+    emit8(&e, 0x55); // push rbp
+    emit8(&e, 0x53); // push rbx
+    EMIT(&e, 0x41, 0x54); // push r12
+    EMIT(&e, 0x41, 0x55); // push r13
+    EMIT(&e, 0x48, 0x83, 0xEC, 0x08); // sub rsp, 8, a scratch slot that also aligns the stack
+    EMIT(&e, 0x48, 0x89, 0xFD); // mov rbp, rdi
+
+    // Blocks are entered from the interpreter, which leaves flags lazy
+    emit8(&e, 0x80); // cmp byte [flags_op], GB15_FLAGS_NONE
+    emit_rbp(&e, 7, CPU_FIELD(flags_op));
+    emit8(&e, (u8)GB15_FLAGS_NONE);
+    emit8(&e, 0x74); // je over the sync
+    u32 synced = e.at;
+    emit8(&e, 0);
+    EMIT(&e, 0x48, 0x8D); // lea rdi, [cpu]
+    emit_rbp(&e, 7, (s32)offsetof(GB15State, cpu));
+    EMIT(&e, 0x48, 0xB8); // mov rax, gb15_cpu_sync_flags
+    emit64(&e, (u64)(uz)gb15_cpu_sync_flags);
+    EMIT(&e, 0xFF, 0xD0); // call rax
+    e.code[synced] = (u8)(e.at - (synced + 1));
+    emit_load(&e);
+
+    e.loop = e.at;
+    bool falls_through = true;
+    for (u32 i = 0; i < block->length && falls_through; i++) {
+        const GB15BlockOp *op = block->ops + i;
+        falls_through = emit_op(&e, op);
+        if (falls_through && i + 1 < block->length && (gb15_op_effects(op->index) & GB15_OP_WRITES)) {
+            emit_check_writes(&e, op->next);
+        }
+    }
+    if (falls_through) {
+        emit_exit(&e, JMP, block->ops[block->length - 1].next);
+    }
+
+    for (u32 i = 0; i < e.num_slow_paths; i++) {
+        emit_slow_path(&e, e.slow_paths + i);
+    }
+
+    u32 epilogue = e.at;
+    emit_store(&e);
+    EMIT(&e, 0x48, 0x83, 0xC4, 0x08); // add rsp, 8
+    EMIT(&e, 0x41, 0x5D); // pop r13
+    EMIT(&e, 0x41, 0x5C); // pop r12
+    emit8(&e, 0x5B); // pop rbx
+    emit8(&e, 0x5D); // pop rbp
+    emit8(&e, 0xC3); // ret
+
+    // Each exit pc gets one stub that stores it
+    u32 stubs[MAX_EXITS];
+    for (u32 i = 0; i < e.num_exits; i++) {
+        const Exit *exit = e.exits + i;
+        stubs[i] = epilogue;
+        if (exit->dynamic) {
+            continue;
+        }
+        u32 j = 0;
+        while (j < i && (e.exits[j].dynamic || e.exits[j].pc != exit->pc)) {
+            j++;
+        }
+        if (j < i) {
+            stubs[i] = stubs[j];
+            continue;
+        }
+        stubs[i] = e.at;
+        EMIT(&e, 0x66, 0xC7); // mov word [pc], pc
+        emit_rbp(&e, 0, CPU_FIELD(pc));
+        emit16(&e, exit->pc);
+        emit8(&e, 0xE9); // jmp epilogue
+        emit32(&e, 0);
+        patch(&e, e.at - 4, epilogue);
+    }
+    for (u32 i = 0; i < e.num_exits; i++) {
+        patch(&e, e.exits[i].at, stubs[i]);
+    }
+
+    if (!protect(cache, cache->code_used, cache->code_used + size, PROT_READ | PROT_EXEC)) {
+        // Blocks sharing these pages can no longer run either
+        flush(cache);
+        gb15_jit_release(cache);
+        return false;
+    }
+    block->native = (GB15NativeBlock)(uz)e.code;
+    cache->code_used += (e.at + 15) & ~(u32)15;
+    return true;
+}
@@ -0,0 +1,23 @@
+#ifndef _GB15_JIT_H_
+#define _GB15_JIT_H_
+
+#include <gb15/gb15.h>
+
+#include "opcodes.h"
+
+typedef u32 (*GB15Handler)(GB15Cpu *cpu, GB15Mmu *mmu, u16 imm);
+
+/**
+ * Interpreter handler for a block op index
+ */
+GB15Handler gb15_cpu_handler(u16 index);
+
+void gb15_jit_init(GB15BlockCache *cache);
+void gb15_jit_release(GB15BlockCache *cache);
+
+/**
+ * Translate a block. Returns false when the block cannot run natively.
+ */
+bool gb15_jit_compile(GB15BlockCache *cache, GB15Block *block);
+
+#endif /* _GB15_JIT_H_ */
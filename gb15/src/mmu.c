@@ -1,28 +1,56 @@
-#include <gb15/mmu.h>
+#include <string.h>
+#include <time.h>
+
+#include <gb15/gb15.h>
 #include <gb15/bios.h>
 
-static u8 mbc0_read(GB15Mmu *mmu, u8 *rom, u16 address) {
+#include "util.h"
+
+/**
+ * The RTC day counter has 9 bits
+ */
+#define RTC_WRAP ((s64)512 * 86400)
+
+/**
+ * OAM DMA holds the bus for one machine cycle per byte. Like the handlers, DMA timings count
+ * machine cycles.
+ */
+#define DMA_CYCLES 160
+
+/**
+ * HBlank and general purpose DMA stall the CPU per block of 16 bytes
+ */
+#define HDMA_BLOCK_CYCLES 8
+
+#define VRAM_BANK_SIZE ((uz)8192)
+#define WRAM_BANK_SIZE ((uz)4096)
+
+static u8 read_io(GB15Mmu *mmu, u8 port);
+static u8 cart_ram_read(GB15Mmu *mmu, u16 address);
+static void cart_ram_write(GB15Mmu *mmu, u16 address, u8 value);
+static void cart_write(GB15Mmu *mmu, u16 address, u8 value);
+
+static u8 mbc0_read(GB15Mmu *mmu, u16 address) {
     switch (address) {
-        case 0x0000 ... 0x7FFF:
-            if (mmu->io[GB15_IO_BIOS] == 0x00 && address < (u16)0x0100) {
-                return GB15_BIOS[address];
-            }
-            return rom[address];
+        case 0x0000 ... 0x7FFF: {
+            const u8 *page = mmu->read_pages[address >> 8];
+            return page != NULL? page[address & (u16)0xFF] : (u8)0xFF;
+        }
         case 0x8000 ... 0x9FFF:
-            return mmu->vram[mmu->io[GB15_IO_VBK] & 0x01][address - (u16)0x8000];
+            return gb15_mmu_vram_bank(mmu)[address - (u16)0x8000];
         case 0xA000 ... 0xBFFF:
-            return mmu->cram[address - (u16)0xA000];
+            return cart_ram_read(mmu, address);
         case 0xC000 ... 0xCFFF:
             return mmu->wram[address - (u16)0xC000];
         case 0xD000 ... 0xDFFF:
-            return mmu->sram[mmu->io[GB15_IO_SVBK] & 0x07][address - (u16)0xD000];
+            return gb15_mmu_wram_bank(mmu)[address - (u16)0xD000];
         case 0xE000 ... 0xFDFF:
-            return mbc0_read(mmu, rom, address - (u16)0x1000);
+            return mbc0_read(mmu, address - (u16)0x1000);
         case 0xFE00 ... 0xFE9F:
             return mmu->oam[address - (u16)0xFE00];
         case 0xFF00 ... 0xFF7F:
         case 0xFFFF:
-            return mmu->io[address - (u16)0xFF00];
+            return read_io(mmu, (u8)address);
         case 0xFF80 ... 0xFFFE:
             return mmu->hram[address - (u16)0xFF80];
         default:
@@ -31,24 +59,367 @@ static u8 mbc0_read(GB15Mmu *mmu, u8 *rom, u16 address) {
     return 0;
 }
 
+/**
+ * Echo RAM mirrors the memory 0x1000 below it
+ */
+static inline u8 echo_source(u8 page) {
+    while (page >= (u8)0xE0 && page <= (u8)0xFD) {
+        page -= (u8)0x10;
+    }
+    return page;
+}
+
+/**
+ * Whether 0xA000-0xBFFF is plain memory. MBC2 nibbles, the MBC3 clock and disabled RAM are not.
+ */
+static inline bool cart_ram_mapped(GB15Mmu *mmu) {
+    switch (mmu->mbc_version) {
+        case GB15_MBC_NONE:
+            return mmu->cram != NULL;
+        case GB15_MBC2:
+            return false;
+        case GB15_MBC3:
+            return mmu->ram_enabled && mmu->ram_banks != 0 && mmu->ram_select <= (u8)0x03;
+        default:
+            return mmu->ram_enabled && mmu->ram_banks != 0;
+    }
+}
+
+/**
+ * Page of cart RAM behind an address in 0xA000-0xBFFF, as currently banked
+ */
+static inline u32 cram_page(GB15Mmu *mmu, u16 address) {
+    return ((u32)mmu->ram_bank << 5) | (u32)((address - (u16)0xA000) >> 8);
+}
+
+static void map_page(GB15Mmu *mmu, u8 page) {
+    u8 source = echo_source(page);
+    const u8 *read = NULL;
+    u8 *write = NULL;
+    switch (source) {
+        case 0x00 ... 0x7F:
+            if (source == (u8)0x00 && mmu->io[GB15_IO_BIOS] == 0x00) {
+                read = GB15_BIOS;
+            } else if (mmu->rom != NULL) {
+                u16 bank = source < (u8)0x40? mmu->rom_bank0 : mmu->rom_bank;
+                read = mmu->rom + ((uz)bank << 14) + ((uz)(source & (u8)0x3F) << 8);
+            }
+            break;
+        case 0x80 ... 0x97:
+            // Tile data is read-only so that every write reaches the slow path and marks its row
+            read = gb15_mmu_vram_bank(mmu) + ((uz)(source - (u8)0x80) << 8);
+            break;
+        case 0x98 ... 0x9F:
+            write = gb15_mmu_vram_bank(mmu) + ((uz)(source - (u8)0x80) << 8);
+            break;
+        case 0xA0 ... 0xBF:
+            if (cart_ram_mapped(mmu)) {
+                u32 index = cram_page(mmu, (u16)source << 8);
+                read = mmu->cram + ((uz)index << 8);
+                if (!mmu->cram_tracked || mmu->cram_dirty[index]) {
+                    write = mmu->cram + ((uz)index << 8);
+                }
+            }
+            break;
+        case 0xC0 ... 0xCF:
+            write = mmu->wram + ((uz)(source - (u8)0xC0) << 8);
+            break;
+        case 0xD0 ... 0xDF:
+            write = gb15_mmu_wram_bank(mmu) + ((uz)(source - (u8)0xD0) << 8);
+            break;
+        default:
+            break;
+    }
+    if (write != NULL) {
+        read = write;
+    }
+    if (mmu->code_pages[source] == GB15_CODE_CACHED) {
+        write = NULL;
+    }
+    if (mmu->dma_active) {
+        read = NULL;
+        write = NULL;
+    }
+    mmu->read_pages[page] = read;
+    mmu->write_pages[page] = write;
+}
+
+static void map_pages(GB15Mmu *mmu, u8 first, u8 last) {
+    for (u32 page = first; page <= last; page++) {
+        map_page(mmu, (u8)page);
+    }
+}
+
+/**
+ * WRAM and its echo
+ */
+static inline void map_wram(GB15Mmu *mmu) {
+    map_pages(mmu, 0xC0, 0xFD);
+}
+
+static inline void touch_code(GB15Mmu *mmu, u16 address) {
+    if (mmu->code_pages[address >> 8] == GB15_CODE_CACHED) {
+        mmu->code_pages[address >> 8] = GB15_CODE_WRITTEN;
+        mmu->code_written = true;
+        map_wram(mmu);
+    }
+}
+
+/**
+ * The MMU only ever lives inside a GB15State, whose other parts IO side effects reach
+ */
+static inline GB15State *mmu_state(GB15Mmu *mmu) {
+    return (GB15State *)(void *)((u8 *)mmu - offsetof(GB15State, mmu));
+}
+
+/**
+ * DIV counts up every 64 machine cycles
+ */
+static u8 div_read(GB15State *state, u8 port) {
+    return (u8)((state->scheduler.cycles - state->mmu.div_base) >> 6);
+}
+
+static void div_write(GB15State *state, u8 port, u8 value) {
+    state->mmu.div_base = state->scheduler.cycles;
+}
+
+static void read_only_write(GB15State *state, u8 port, u8 value) {
+}
+
+#ifdef GB15_DMG_ONLY
+/**
+ * Registers of the Gameboy Color, which read as open bus and ignore writes on older models
+ */
+static u8 unmapped_read(GB15State *state, u8 port) {
+    return 0xFF;
+}
+#endif
+
+/**
+ * Copy memory the way the DMA engines see it. Never crosses a page when the source is plain memory.
+ */
+static void dma_copy(GB15Mmu *mmu, u8 *dest, u16 source, u16 length) {
+    const u8 *page = mmu->read_pages[source >> 8];
+    if (page != NULL && (source & (u16)0xFF) + length <= (u16)0x100) {
+        memcpy(dest, page + (source & (u16)0xFF), length);
+        return;
+    }
+    for (u16 i = 0; i < length; i++) {
+        dest[i] = mbc0_read(mmu, source + i);
+    }
+}
+
+/**
+ * OAM DMA copies all 160 bytes at the time of the write, then keeps the CPU off the bus for as
+ * long as the transfer would have taken
+ */
+static void dma_write(GB15State *state, u8 port, u8 value) {
+    GB15Mmu *mmu = &state->mmu;
+    if (mmu->dma_active) {
+        gb15_mmu_dma_end(mmu);
+    }
+    mmu->io[GB15_IO_DMA] = value;
+    dma_copy(mmu, mmu->oam, (u16)value << 8, (u16)sizeof(mmu->oam));
+    mmu->dma_active = true;
+    mmu->code_written = true; // blocks already decoded outside HRAM must not keep running
+    memset(mmu->read_pages, 0, sizeof(mmu->read_pages));
+    memset(mmu->write_pages, 0, sizeof(mmu->write_pages));
+    gb15_scheduler_schedule(&state->scheduler, GB15_EVENT_DMA_END, state->scheduler.cycles + DMA_CYCLES);
+}
+
+#ifndef GB15_DMG_ONLY
+/**
+ * Copy one block from HDMA1/HDMA2 into the current VRAM bank at HDMA3/HDMA4, moving both on
+ */
+static void hdma_block(GB15Mmu *mmu) {
+    u16 source = (((u16)mmu->io[GB15_IO_HDMA1] << 8) | mmu->io[GB15_IO_HDMA2]) & (u16)0xFFF0;
+    u16 dest = (((u16)mmu->io[GB15_IO_HDMA3] << 8) | mmu->io[GB15_IO_HDMA4]) & (u16)0x1FF0;
+    u8 bank = gb15_mmu_vram_bank_index(mmu);
+    dma_copy(mmu, mmu->vram[bank] + dest, source, 16);
+    for (u8 row = 0; row < 16; row += 2) {
+        gb15_gpu_vram_written(&mmu_state(mmu)->gpu, bank, dest + row);
+    }
+    source += (u16)16;
+    dest += (u16)16;
+    mmu->io[GB15_IO_HDMA1] = (u8)(source >> 8);
+    mmu->io[GB15_IO_HDMA2] = (u8)source;
+    mmu->io[GB15_IO_HDMA3] = (u8)(dest >> 8) & (u8)0x1F;
+    mmu->io[GB15_IO_HDMA4] = (u8)dest;
+}
+
+/**
+ * Blocks left minus one while HBlank DMA runs. Otherwise 0xFF, or the blocks that were left with
+ * bit 7 set when it was stopped.
+ */
+static u8 hdma_read(GB15State *state, u8 port) {
+    GB15Mmu *mmu = &state->mmu;
+    if (!mmu->cgb) {
+        return 0xFF;
+    }
+    if (mmu->hdma_blocks != 0) {
+        return mmu->hdma_blocks - (u8)1;
+    }
+    return mmu->io[GB15_IO_HDMA5];
+}
+
+/**
+ * Bit 7 starts HBlank DMA. Without it the whole length is copied at once as general purpose DMA,
+ * unless HBlank DMA is running, which it stops.
+ */
+static void hdma_write(GB15State *state, u8 port, u8 value) {
+    GB15Mmu *mmu = &state->mmu;
+    if (!mmu->cgb) {
+        return;
+    }
+    u8 blocks = (value & (u8)0x7F) + (u8)1;
+    if (value & (u8)0x80) {
+        mmu->hdma_blocks = blocks;
+        return;
+    }
+    if (mmu->hdma_blocks != 0) {
+        mmu->io[GB15_IO_HDMA5] = (u8)0x80 | (mmu->hdma_blocks - (u8)1);
+        mmu->hdma_blocks = 0;
+        return;
+    }
+    for (u8 i = 0; i < blocks; i++) {
+        hdma_block(mmu);
+    }
+    mmu->io[GB15_IO_HDMA5] = 0xFF;
+    state->scheduler.cycles += (u64)blocks * HDMA_BLOCK_CYCLES;
+}
+#endif
+
+/**
+ * The BIOS stays unmapped once any non-zero value is written
+ */
+static void bios_write(GB15State *state, u8 port, u8 value) {
+    GB15Mmu *mmu = &state->mmu;
+    if (mmu->io[GB15_IO_BIOS] == 0x00) {
+        mmu->io[GB15_IO_BIOS] = value;
+        map_page(mmu, 0x00);
+    }
+}
+
+#ifndef GB15_DMG_ONLY
+/**
+ * The banking, HDMA and palette registers do not exist for games that predate the Gameboy Color
+ */
+static u8 cgb_only_read(GB15State *state, u8 port) {
+    return state->mmu.cgb? state->mmu.io[port] : (u8)0xFF;
+}
+
+static void vbk_write(GB15State *state, u8 port, u8 value) {
+    GB15Mmu *mmu = &state->mmu;
+    if (!mmu->cgb) {
+        return;
+    }
+    mmu->io[GB15_IO_VBK] = (u8)0xFE | (value & (u8)0x01);
+    map_pages(mmu, 0x80, 0x9F);
+}
+
+/**
+ * Bank 0 is fixed at 0xC000, so selecting it maps bank 1. The unused bits read back set.
+ */
+static void svbk_write(GB15State *state, u8 port, u8 value) {
+    GB15Mmu *mmu = &state->mmu;
+    if (!mmu->cgb) {
+        return;
+    }
+    u8 bank = value & (u8)0x07;
+    mmu->io[GB15_IO_SVBK] = (u8)0xF8 | (bank == 0? (u8)0x01 : bank);
+    map_wram(mmu);
+}
+#endif
+
+typedef struct IOHandler {
+    /**
+     * Value the register reads as, when it is not simply the stored byte
+     */
+    u8 (*read)(GB15State *state, u8 port);
+
+    /**
+     * Side effects of a write, applied once as it happens. Stores whatever the register keeps.
+     */
+    void (*write)(GB15State *state, u8 port, u8 value);
+
+} IOHandler;
+
+/**
+ * Registers with side effects, indexed by port. Every other register is plain storage in io.
+ */
+static const IOHandler IO_HANDLERS[256] = {
+        [GB15_IO_DIV] =  {div_read, div_write},
+        [GB15_IO_LCDC] = {NULL, gb15_gpu_write_lcdc},
+        [GB15_IO_STAT] = {NULL, gb15_gpu_write_stat},
+        [GB15_IO_LY] =   {NULL, read_only_write},
+        [GB15_IO_LYC] =  {NULL, gb15_gpu_write_lyc},
+        [GB15_IO_DMA] =  {NULL, dma_write},
+        [GB15_IO_BIOS] = {NULL, bios_write},
+#ifdef GB15_DMG_ONLY
+        [GB15_IO_HDMA5] = {unmapped_read, read_only_write},
+        [GB15_IO_VBK] =  {unmapped_read, read_only_write},
+        [GB15_IO_SVBK] = {unmapped_read, read_only_write},
+        [GB15_IO_BCPS] = {unmapped_read, read_only_write},
+        [GB15_IO_BCPD] = {unmapped_read, read_only_write},
+        [GB15_IO_OCPS] = {unmapped_read, read_only_write},
+        [GB15_IO_OCPD] = {unmapped_read, read_only_write},
+#else
+        [GB15_IO_HDMA5] = {hdma_read, hdma_write},
+        [GB15_IO_VBK] =  {cgb_only_read, vbk_write},
+        [GB15_IO_SVBK] = {cgb_only_read, svbk_write},
+        [GB15_IO_BCPS] = {cgb_only_read, gb15_gpu_write_cps},
+        [GB15_IO_BCPD] = {gb15_gpu_read_cpd, gb15_gpu_write_cpd},
+        [GB15_IO_OCPS] = {cgb_only_read, gb15_gpu_write_cps},
+        [GB15_IO_OCPD] = {gb15_gpu_read_cpd, gb15_gpu_write_cpd},
+#endif
+};
+
+static u8 read_io(GB15Mmu *mmu, u8 port) {
+    const IOHandler *handler = IO_HANDLERS + port;
+    if (handler->read != NULL) {
+        return handler->read(mmu_state(mmu), port);
+    }
+    return mmu->io[port];
+}
+
+static inline void write_io(GB15Mmu *mmu, u8 port, u8 value) {
+    const IOHandler *handler = IO_HANDLERS + port;
+    if (handler->write != NULL) {
+        handler->write(mmu_state(mmu), port, value);
+    } else {
+        mmu->io[port] = value;
+    }
+}
+
 static u8 mbc0_write(GB15Mmu *mmu, u16 address, u8 value) {
     switch (address) {
-        case 0x8000 ... 0x9FFF:
-            return mmu->vram[mmu->io[GB15_IO_VBK] & 0x01][address - (u16)0x8000] = value;
+        case 0x0000 ... 0x7FFF:
+            cart_write(mmu, address, value);
+            return value;
+        case 0x8000 ... 0x9FFF: {
+            u8 bank = gb15_mmu_vram_bank_index(mmu);
+            gb15_gpu_vram_written(&mmu_state(mmu)->gpu, bank, address - (u16)0x8000);
+            return mmu->vram[bank][address - (u16)0x8000] = value;
+        }
         case 0xA000 ... 0xBFFF:
-            return mmu->cram[address - (u16)0xA000] = value;
+            cart_ram_write(mmu, address, value);
+            return value;
         case 0xC000 ... 0xCFFF:
+            touch_code(mmu, address);
             return mmu->wram[address - (u16)0xC000] = value;
         case 0xD000 ... 0xDFFF:
-            return mmu->sram[mmu->io[GB15_IO_SVBK] & 0x07][address - (u16)0xD000] = value;
+            touch_code(mmu, address);
+            return gb15_mmu_wram_bank(mmu)[address - (u16)0xD000] = value;
         case 0xE000 ... 0xFDFF:
             return mbc0_write(mmu, address - (u16)0x1000, value);
         case 0xFE00 ... 0xFE9F:
             return mmu->oam[address - (u16)0xFE00] = value;
         case 0xFF00 ... 0xFF7F:
         case 0xFFFF:
-            return mmu->io[address - (u16)0xFF00] = value;
+            write_io(mmu, (u8)address, value);
+            return value;
         case 0xFF80 ... 0xFFFE:
+            touch_code(mmu, address);
             return mmu->hram[address - (u16)0xFF80] = value;
         default:
             break;
@@ -56,10 +427,385 @@ static u8 mbc0_write(GB15Mmu *mmu, u16 address, u8 value) {
     return 0;
 }
 
-u8 gb15_mmu_read(GB15Mmu *mmu, u8 *rom, u16 address) {
-    return mbc0_read(mmu, rom, address);
+static s64 rtc_counter(const GB15Rtc *rtc) {
+    return rtc->halted? rtc->halted_at : (s64)time(NULL) - rtc->base;
+}
+
+static void rtc_set_counter(GB15Rtc *rtc, s64 counter) {
+    if (rtc->halted) {
+        rtc->halted_at = counter;
+    } else {
+        rtc->base = (s64)time(NULL) - counter;
+    }
+}
+
+/**
+ * Running counter in seconds, folding day overflow into the carry flag
+ */
+static s64 rtc_wrapped_counter(GB15Rtc *rtc) {
+    s64 counter = rtc_counter(rtc);
+    if (counter < 0) { // host clock went backwards
+        counter = 0;
+        rtc_set_counter(rtc, counter);
+    } else if (counter >= RTC_WRAP) {
+        rtc->carry = true;
+        counter %= RTC_WRAP;
+        rtc_set_counter(rtc, counter);
+    }
+    return counter;
+}
+
+static void rtc_latch(GB15Rtc *rtc) {
+    s64 counter = rtc_wrapped_counter(rtc);
+    u16 days = (u16)(counter / 86400);
+    rtc->latched[0] = (u8)(counter % 60);
+    rtc->latched[1] = (u8)(counter / 60 % 60);
+    rtc->latched[2] = (u8)(counter / 3600 % 24);
+    rtc->latched[3] = (u8)days;
+    rtc->latched[4] = (u8)(days >> 8) | ((u8)rtc->halted << 6) | ((u8)rtc->carry << 7);
+}
+
+static void rtc_write(GB15Rtc *rtc, u8 reg, u8 value) {
+    s64 counter = rtc_wrapped_counter(rtc);
+    s64 seconds = counter % 60;
+    s64 minutes = counter / 60 % 60;
+    s64 hours = counter / 3600 % 24;
+    s64 days = counter / 86400;
+    switch (reg) {
+        case 0x08:
+            seconds = value & 0x3F;
+            break;
+        case 0x09:
+            minutes = value & 0x3F;
+            break;
+        case 0x0A:
+            hours = value & 0x1F;
+            break;
+        case 0x0B:
+            days = (days & 0x100) | value;
+            break;
+        case 0x0C:
+            days = (days & 0xFF) | ((s64)(value & 0x01) << 8);
+            rtc->carry = (value & 0x80) != 0;
+            rtc->halted = (value & 0x40) != 0;
+            break;
+        default:
+            return;
+    }
+    rtc_set_counter(rtc, ((days * 24 + hours) * 60 + minutes) * 60 + seconds);
+}
+
+/**
+ * First write to a clean page since the last flush. Once marked it is mapped writable again.
+ */
+static inline void touch_cram(GB15Mmu *mmu, u32 index) {
+    if (mmu->cram_tracked && !mmu->cram_dirty[index]) {
+        mmu->cram_dirty[index] = true;
+        map_page(mmu, (u8)(0xA0 + (index & 0x1F)));
+    }
+}
+
+static u8 cart_ram_read(GB15Mmu *mmu, u16 address) {
+    if (cart_ram_mapped(mmu)) {
+        return mmu->cram[((uz)cram_page(mmu, address) << 8) | (address & (u16)0xFF)];
+    }
+    if (!mmu->ram_enabled) {
+        return 0xFF;
+    }
+    switch (mmu->mbc_version) {
+        case GB15_MBC2: // 512 half bytes, repeated across the window
+            return (u8)0xF0 | mmu->cram[address & (u16)0x01FF];
+        case GB15_MBC3:
+            if (mmu->ram_select >= (u8)0x08 && mmu->ram_select <= (u8)0x0C) {
+                return mmu->rtc.latched[mmu->ram_select - (u8)0x08];
+            }
+            break;
+        default:
+            break;
+    }
+    return 0xFF;
+}
+
+static void cart_ram_write(GB15Mmu *mmu, u16 address, u8 value) {
+    if (cart_ram_mapped(mmu)) {
+        u32 index = cram_page(mmu, address);
+        mmu->cram[((uz)index << 8) | (address & (u16)0xFF)] = value;
+        touch_cram(mmu, index);
+        return;
+    }
+    if (!mmu->ram_enabled) {
+        return;
+    }
+    switch (mmu->mbc_version) {
+        case GB15_MBC2:
+            mmu->cram[address & (u16)0x01FF] = value & (u8)0x0F;
+            touch_cram(mmu, (u32)((address & (u16)0x01FF) >> 8));
+            break;
+        case GB15_MBC3:
+            rtc_write(&mmu->rtc, mmu->ram_select, value);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Derive the mapped banks from the bank registers and swap the page pointers of whatever changed.
+ * Code may be running from a bank that just went away, so the run loop is made to leave its block.
+ */
+static void update_banks(GB15Mmu *mmu) {
+    u16 rom_bank0 = 0;
+    u16 rom_bank;
+    u8 ram_bank = 0;
+    switch (mmu->mbc_version) {
+        case GB15_MBC1:
+            rom_bank = (mmu->rom_select & (u16)0x1F) == 0? (u16)1 : mmu->rom_select & (u16)0x1F;
+            rom_bank |= (u16)(mmu->ram_select & 0x03) << 5;
+            if (mmu->bank_mode) {
+                rom_bank0 = (u16)(mmu->ram_select & 0x03) << 5;
+                ram_bank = mmu->ram_select & (u8)0x03;
+            }
+            break;
+        case GB15_MBC2:
+            rom_bank = (mmu->rom_select & (u16)0x0F) == 0? (u16)1 : mmu->rom_select & (u16)0x0F;
+            break;
+        case GB15_MBC3:
+            rom_bank = (mmu->rom_select & (u16)0x7F) == 0? (u16)1 : mmu->rom_select & (u16)0x7F;
+            ram_bank = mmu->ram_select & (u8)0x03;
+            break;
+        case GB15_MBC5:
+            rom_bank = mmu->rom_select & (u16)0x1FF;
+            ram_bank = mmu->ram_select & (u8)0x0F;
+            break;
+        default:
+            rom_bank = 1;
+            break;
+    }
+    rom_bank0 &= mmu->rom_banks - (u16)1;
+    rom_bank &= mmu->rom_banks - (u16)1;
+    ram_bank &= mmu->ram_banks == 0? (u8)0 : mmu->ram_banks - (u8)1;
+
+    if (rom_bank0 != mmu->rom_bank0) {
+        mmu->rom_bank0 = rom_bank0;
+        mmu->code_written = true;
+        map_pages(mmu, 0x00, 0x3F);
+    }
+    if (rom_bank != mmu->rom_bank) {
+        mmu->rom_bank = rom_bank;
+        mmu->code_written = true;
+        map_pages(mmu, 0x40, 0x7F);
+    }
+    mmu->ram_bank = ram_bank;
+    map_pages(mmu, 0xA0, 0xBF);
+}
+
+static void cart_write(GB15Mmu *mmu, u16 address, u8 value) {
+    bool ram_enabled = mmu->ram_enabled;
+    switch (mmu->mbc_version) {
+        case GB15_MBC1:
+        case GB15_MBC3:
+            switch (address) {
+                case 0x0000 ... 0x1FFF:
+                    mmu->ram_enabled = (value & 0x0F) == 0x0A;
+                    break;
+                case 0x2000 ... 0x3FFF:
+                    mmu->rom_select = value;
+                    break;
+                case 0x4000 ... 0x5FFF:
+                    mmu->ram_select = value;
+                    break;
+                default:
+                    if (mmu->mbc_version == GB15_MBC1) {
+                        mmu->bank_mode = value & (u8)0x01;
+                    } else {
+                        if (mmu->rtc.latch == 0x00 && value == 0x01) {
+                            rtc_latch(&mmu->rtc);
+                        }
+                        mmu->rtc.latch = value;
+                    }
+                    break;
+            }
+            break;
+        case GB15_MBC2:
+            if (address >= (u16)0x4000) {
+                return;
+            }
+            if (address & (u16)0x0100) {
+                mmu->rom_select = value;
+            } else {
+                mmu->ram_enabled = (value & 0x0F) == 0x0A;
+            }
+            break;
+        case GB15_MBC5:
+            switch (address) {
+                case 0x0000 ... 0x1FFF:
+                    mmu->ram_enabled = (value & 0x0F) == 0x0A;
+                    break;
+                case 0x2000 ... 0x2FFF:
+                    mmu->rom_select = (mmu->rom_select & (u16)0x100) | value;
+                    break;
+                case 0x3000 ... 0x3FFF:
+                    mmu->rom_select = (mmu->rom_select & (u16)0xFF) | ((u16)(value & 0x01) << 8);
+                    break;
+                case 0x4000 ... 0x5FFF:
+                    mmu->ram_select = value;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            return;
+    }
+    if (ram_enabled && !mmu->ram_enabled && mmu->cram_tracked) {
+        mmu->save_due = true;
+    }
+    update_banks(mmu);
+}
+
+/**
+ * Read the mapper from the cartridge header and reset it to its power-on banks
+ */
+static void attach_rom(GB15Mmu *mmu, const GB15Cartridge *cartridge) {
+    const GB15CartridgeHeader *header = &cartridge->header;
+    mmu->rom = cartridge->rom;
+    mmu->mbc_version = (u8)header->mbc;
+    mmu->rom_banks = header->rom_banks;
+    mmu->ram_banks = header->ram_banks;
+    mmu->rom_select = 1;
+    mmu->ram_select = 0;
+    mmu->bank_mode = 0;
+    mmu->ram_enabled = mmu->mbc_version == GB15_MBC_NONE;
+    update_banks(mmu);
 }
 
-u8 gb15_mmu_write(GB15Mmu *mmu, u16 address, u8 value) {
+/**
+ * Map VRAM, WRAM and cart RAM for a cartridge in one block: each VRAM bank, WRAM, each switchable
+ * WRAM bank, then cart RAM. Banks the cartridge cannot use point at bank 0 instead.
+ */
+static bool allocate_banks(GB15Mmu *mmu, const GB15Cartridge *cartridge) {
+    u32 ram_size = cartridge != NULL? cartridge->header.ram_size : 0;
+    u32 vram_banks = 1;
+    u32 wram_banks = 1;
+#ifndef GB15_DMG_ONLY
+    mmu->cgb = cartridge != NULL && (cartridge->header.cgb & GB15_CGB_SUPPORTED);
+    if (mmu->cgb) {
+        vram_banks = GB15_VRAM_BANKS;
+        wram_banks = GB15_WRAM_BANKS - 1;
+    }
+#endif
+    uz size = (uz)vram_banks * VRAM_BANK_SIZE + (uz)(wram_banks + 1) * WRAM_BANK_SIZE + ram_size;
+    mmu->memory = gb15_pages_alloc(size);
+    if (mmu->memory == NULL) {
+        return false;
+    }
+    mmu->memory_size = size;
+
+    u8 *memory = mmu->memory;
+    for (u32 bank = 0; bank < GB15_VRAM_BANKS; bank++) {
+        mmu->vram[bank] = memory + (uz)(bank < vram_banks? bank : 0) * VRAM_BANK_SIZE;
+    }
+    memory += (uz)vram_banks * VRAM_BANK_SIZE;
+    mmu->wram = memory;
+    memory += WRAM_BANK_SIZE;
+    for (u32 bank = 0; bank < GB15_WRAM_BANKS; bank++) {
+        u32 index = bank == 0 || bank > wram_banks? 0 : bank - 1;
+        mmu->sram[bank] = memory + (uz)index * WRAM_BANK_SIZE;
+    }
+    memory += (uz)wram_banks * WRAM_BANK_SIZE;
+    mmu->cram_memory = ram_size != 0? memory : NULL;
+    mmu->cram = mmu->cram_memory;
+    return true;
+}
+
+bool gb15_mmu_init(GB15Mmu *mmu, const GB15Cartridge *cartridge) {
+    gb15_mmu_release(mmu);
+    mmu->rom = NULL;
+    mmu->mbc_version = GB15_MBC_NONE;
+    mmu->rom_bank0 = 0;
+    mmu->rom_bank = 1;
+    mmu->ram_bank = 0;
+    mmu->rtc.base = (s64)time(NULL);
+    mmu->cram_tracked = false;
+    mmu->save_due = false;
+    mmu->dma_active = false;
+#ifndef GB15_DMG_ONLY
+    mmu->hdma_blocks = 0;
+#endif
+    mmu->code_written = false;
+    mmu->div_base = 0;
+    memset(mmu->io, 0, sizeof(mmu->io));
+#ifndef GB15_DMG_ONLY
+    mmu->io[GB15_IO_VBK] = 0xFE;
+    mmu->io[GB15_IO_SVBK] = 0xF9;
+#endif
+    memset(mmu->hram, 0, sizeof(mmu->hram));
+    memset(mmu->oam, 0, sizeof(mmu->oam));
+    memset(mmu->code_pages, 0, sizeof(mmu->code_pages));
+    if (!allocate_banks(mmu, cartridge)) {
+        return false;
+    }
+    if (cartridge != NULL) {
+        attach_rom(mmu, cartridge);
+    }
+    map_pages(mmu, 0x00, 0xFF);
+    return true;
+}
+
+void gb15_mmu_release(GB15Mmu *mmu) {
+    gb15_pages_free(mmu->memory, mmu->memory_size);
+    mmu->memory = NULL;
+    mmu->memory_size = 0;
+    mmu->cram_memory = NULL;
+    mmu->cram = NULL;
+#ifndef GB15_DMG_ONLY
+    mmu->cgb = false;
+#endif
+}
+
+void gb15_mmu_map_cram(GB15Mmu *mmu, u8 *cram, bool tracked) {
+    mmu->cram = cram;
+    mmu->cram_tracked = tracked;
+    memset(mmu->cram_dirty, 0, sizeof(mmu->cram_dirty));
+    mmu->save_due = false;
+    map_pages(mmu, 0xA0, 0xBF);
+}
+
+void gb15_mmu_dma_end(GB15Mmu *mmu) {
+    mmu->dma_active = false;
+    map_pages(mmu, 0x00, 0xFF);
+}
+
+#ifndef GB15_DMG_ONLY
+u32 gb15_mmu_hdma_hblank(GB15Mmu *mmu) {
+    if (mmu->hdma_blocks == 0) {
+        return 0;
+    }
+    hdma_block(mmu);
+    if (--mmu->hdma_blocks == 0) {
+        mmu->io[GB15_IO_HDMA5] = 0xFF;
+    }
+    return HDMA_BLOCK_CYCLES;
+}
+#endif
+
+void gb15_mmu_cache_code(GB15Mmu *mmu, u16 address) {
+    if (mmu->code_pages[address >> 8] != GB15_CODE_CACHED) {
+        mmu->code_pages[address >> 8] = GB15_CODE_CACHED;
+        map_wram(mmu);
+    }
+}
+
+u8 gb15_mmu_read_slow(GB15Mmu *mmu, u16 address) {
+    if (mmu->dma_active && address < (u16)0xFF00) {
+        return 0xFF;
+    }
+    return mbc0_read(mmu, address);
+}
+
+u8 gb15_mmu_write_slow(GB15Mmu *mmu, u16 address, u8 value) {
+    if (mmu->dma_active && address < (u16)0xFF00) {
+        return value;
+    }
     return mbc0_write(mmu, address, value);
 }
@@ -0,0 +1,395 @@
+#ifndef _GB15_OPCODES_H_
+#define _GB15_OPCODES_H_
+
+#include <gb15/types.h>
+
+/**
+ * Opcode tables as X-macros: X(opcode, num_operands, name, handler)
+ */
+
+#define CB_OPCODES(X) \
+        X(0x00, 0, "rlc b", rlc_b)              X(0x01, 0, "rlc c", rlc_c)      \
+        X(0x02, 0, "rlc d", rlc_d)              X(0x03, 0, "rlc e", rlc_e)      \
+        X(0x04, 0, "rlc h", rlc_h)              X(0x05, 0, "rlc l", rlc_l)      \
+        X(0x06, 0, "rlc (hl)", rlc_mem_hl)      X(0x07, 0, "rlc a", rlc_a)      \
+        X(0x08, 0, "rrc b", rrc_b)              X(0x09, 0, "rrc c", rrc_c)      \
+        X(0x0A, 0, "rrc d", rrc_d)              X(0x0B, 0, "rrc e", rrc_e)      \
+        X(0x0C, 0, "rrc h", rrc_h)              X(0x0D, 0, "rrc l", rrc_l)      \
+        X(0x0E, 0, "rrc (hl)", rrc_mem_hl)      X(0x0F, 0, "rrc a", rrc_a)      \
+                                                                                \
+        X(0x10, 0, "rl b", rl_b)                X(0x11, 0, "rl c", rl_c)        \
+        X(0x12, 0, "rl d", rl_d)                X(0x13, 0, "rl e", rl_e)        \
+        X(0x14, 0, "rl h", rl_h)                X(0x15, 0, "rl l", rl_l)        \
+        X(0x16, 0, "rl (hl)", rl_mem_hl)        X(0x17, 0, "rl a", rl_a)        \
+        X(0x18, 0, "rr b", rr_b)                X(0x19, 0, "rr c", rr_c)        \
+        X(0x1A, 0, "rr d", rr_d)                X(0x1B, 0, "rr e", rr_e)        \
+        X(0x1C, 0, "rr h", rr_h)                X(0x1D, 0, "rr l", rr_l)        \
+        X(0x1E, 0, "rr (hl)", rr_mem_hl)        X(0x1F, 0, "rr a", rr_a)        \
+                                                                                \
+        X(0x20, 0, "sla b", sla_b)              X(0x21, 0, "sla c", sla_c)      \
+        X(0x22, 0, "sla d", sla_d)              X(0x23, 0, "sla e", sla_e)      \
+        X(0x24, 0, "sla h", sla_h)              X(0x25, 0, "sla l", sla_l)      \
+        X(0x26, 0, "sla (hl)", sla_mem_hl)      X(0x27, 0, "sla a", sla_a)      \
+        X(0x28, 0, "sra b", sra_b)              X(0x29, 0, "sra c", sra_c)      \
+        X(0x2A, 0, "sra d", sra_d)              X(0x2B, 0, "sra e", sra_e)      \
+        X(0x2C, 0, "sra h", sra_h)              X(0x2D, 0, "sra l", sra_l)      \
+        X(0x2E, 0, "sra (hl)", sra_mem_hl)      X(0x2F, 0, "sra a", sra_a)      \
+                                                                                \
+        X(0x30, 0, "swap b", swap_b)            X(0x31, 0, "swap c", swap_c)    \
+        X(0x32, 0, "swap d", swap_d)            X(0x33, 0, "swap e", swap_e)    \
+        X(0x34, 0, "swap h", swap_h)            X(0x35, 0, "swap l", swap_l)    \
+        X(0x36, 0, "swap (hl)", swap_mem_hl)    X(0x37, 0, "swap a", swap_a)    \
+        X(0x38, 0, "srl b", srl_b)              X(0x39, 0, "srl c", srl_c)      \
+        X(0x3A, 0, "srl d", srl_d)              X(0x3B, 0, "srl e", srl_e)      \
+        X(0x3C, 0, "srl h", srl_h)              X(0x3D, 0, "srl l", srl_l)      \
+        X(0x3E, 0, "srl (hl)", srl_mem_hl)      X(0x3F, 0, "srl a", srl_a)      \
+                                                                                \
+        X(0x40, 0, "bit 0, b", bit_0_b)         X(0x41, 0, "bit 0, c", bit_0_c) \
+        X(0x42, 0, "bit 0, d", bit_0_d)         X(0x43, 0, "bit 0, e", bit_0_e) \
+        X(0x44, 0, "bit 0, h", bit_0_h)         X(0x45, 0, "bit 0, l", bit_0_l) \
+        X(0x46, 0, "bit 0, (hl)", bit_0_mem_hl) X(0x47, 0, "bit 0, a", bit_0_a) \
+        X(0x48, 0, "bit 1, b", bit_1_b)         X(0x49, 0, "bit 1, c", bit_1_c) \
+        X(0x4A, 0, "bit 1, d", bit_1_d)         X(0x4B, 0, "bit 1, e", bit_1_e) \
+        X(0x4C, 0, "bit 1, h", bit_1_h)         X(0x4D, 0, "bit 1, l", bit_1_l) \
+        X(0x4E, 0, "bit 1, (hl)", bit_1_mem_hl) X(0x4F, 0, "bit 1, a", bit_1_a) \
+                                                                                \
+        X(0x50, 0, "bit 2, b", bit_2_b)         X(0x51, 0, "bit 2, c", bit_2_c) \
+        X(0x52, 0, "bit 2, d", bit_2_d)         X(0x53, 0, "bit 2, e", bit_2_e) \
+        X(0x54, 0, "bit 2, h", bit_2_h)         X(0x55, 0, "bit 2, l", bit_2_l) \
+        X(0x56, 0, "bit 2, (hl)", bit_2_mem_hl) X(0x57, 0, "bit 2, a", bit_2_a) \
+        X(0x58, 0, "bit 3, b", bit_3_b)         X(0x59, 0, "bit 3, c", bit_3_c) \
+        X(0x5A, 0, "bit 3, d", bit_3_d)         X(0x5B, 0, "bit 3, e", bit_3_e) \
+        X(0x5C, 0, "bit 3, h", bit_3_h)         X(0x5D, 0, "bit 3, l", bit_3_l) \
+        X(0x5E, 0, "bit 3, (hl)", bit_3_mem_hl) X(0x5F, 0, "bit 3, a", bit_3_a) \
+                                                                                \
+        X(0x60, 0, "bit 4, b", bit_4_b)         X(0x61, 0, "bit 4, c", bit_4_c) \
+        X(0x62, 0, "bit 4, d", bit_4_d)         X(0x63, 0, "bit 4, e", bit_4_e) \
+        X(0x64, 0, "bit 4, h", bit_4_h)         X(0x65, 0, "bit 4, l", bit_4_l) \
+        X(0x66, 0, "bit 4, (hl)", bit_4_mem_hl) X(0x67, 0, "bit 4, a", bit_4_a) \
+        X(0x68, 0, "bit 5, b", bit_5_b)         X(0x69, 0, "bit 5, c", bit_5_c) \
+        X(0x6A, 0, "bit 5, d", bit_5_d)         X(0x6B, 0, "bit 5, e", bit_5_e) \
+        X(0x6C, 0, "bit 5, h", bit_5_h)         X(0x6D, 0, "bit 5, l", bit_5_l) \
+        X(0x6E, 0, "bit 5, (hl)", bit_5_mem_hl) X(0x6F, 0, "bit 5, a", bit_5_a) \
+                                                                                \
+        X(0x70, 0, "bit 6, b", bit_6_b)         X(0x71, 0, "bit 6, c", bit_6_c) \
+        X(0x72, 0, "bit 6, d", bit_6_d)         X(0x73, 0, "bit 6, e", bit_6_e) \
+        X(0x74, 0, "bit 6, h", bit_6_h)         X(0x75, 0, "bit 6, l", bit_6_l) \
+        X(0x76, 0, "bit 6, (hl)", bit_6_mem_hl) X(0x77, 0, "bit 6, a", bit_6_a) \
+        X(0x78, 0, "bit 7, b", bit_7_b)         X(0x79, 0, "bit 7, c", bit_7_c) \
+        X(0x7A, 0, "bit 7, d", bit_7_d)         X(0x7B, 0, "bit 7, e", bit_7_e) \
+        X(0x7C, 0, "bit 7, h", bit_7_h)         X(0x7D, 0, "bit 7, l", bit_7_l) \
+        X(0x7E, 0, "bit 7, (hl)", bit_7_mem_hl) X(0x7F, 0, "bit 7, a", bit_7_a) \
+                                                                                \
+        X(0x80, 0, "res 0, b", res_0_b)         X(0x81, 0, "res 0, c", res_0_c) \
+        X(0x82, 0, "res 0, d", res_0_d)         X(0x83, 0, "res 0, e", res_0_e) \
+        X(0x84, 0, "res 0, h", res_0_h)         X(0x85, 0, "res 0, l", res_0_l) \
+        X(0x86, 0, "res 0, (hl)", res_0_mem_hl) X(0x87, 0, "res 0, a", res_0_a) \
+        X(0x88, 0, "res 1, b", res_1_b)         X(0x89, 0, "res 1, c", res_1_c) \
+        X(0x8A, 0, "res 1, d", res_1_d)         X(0x8B, 0, "res 1, e", res_1_e) \
+        X(0x8C, 0, "res 1, h", res_1_h)         X(0x8D, 0, "res 1, l", res_1_l) \
+        X(0x8E, 0, "res 1, (hl)", res_1_mem_hl) X(0x8F, 0, "res 1, a", res_1_a) \
+                                                                                \
+        X(0x90, 0, "res 2, b", res_2_b)         X(0x91, 0, "res 2, c", res_2_c) \
+        X(0x92, 0, "res 2, d", res_2_d)         X(0x93, 0, "res 2, e", res_2_e) \
+        X(0x94, 0, "res 2, h", res_2_h)         X(0x95, 0, "res 2, l", res_2_l) \
+        X(0x96, 0, "res 2, (hl)", res_2_mem_hl) X(0x97, 0, "res 2, a", res_2_a) \
+        X(0x98, 0, "res 3, b", res_3_b)         X(0x99, 0, "res 3, c", res_3_c) \
+        X(0x9A, 0, "res 3, d", res_3_d)         X(0x9B, 0, "res 3, e", res_3_e) \
+        X(0x9C, 0, "res 3, h", res_3_h)         X(0x9D, 0, "res 3, l", res_3_l) \
+        X(0x9E, 0, "res 3, (hl)", res_3_mem_hl) X(0x9F, 0, "res 3, a", res_3_a) \
+                                                                                \
+        X(0xA0, 0, "res 4, b", res_4_b)         X(0xA1, 0, "res 4, c", res_4_c) \
+        X(0xA2, 0, "res 4, d", res_4_d)         X(0xA3, 0, "res 4, e", res_4_e) \
+        X(0xA4, 0, "res 4, h", res_4_h)         X(0xA5, 0, "res 4, l", res_4_l) \
+        X(0xA6, 0, "res 4, (hl)", res_4_mem_hl) X(0xA7, 0, "res 4, a", res_4_a) \
+        X(0xA8, 0, "res 5, b", res_5_b)         X(0xA9, 0, "res 5, c", res_5_c) \
+        X(0xAA, 0, "res 5, d", res_5_d)         X(0xAB, 0, "res 5, e", res_5_e) \
+        X(0xAC, 0, "res 5, h", res_5_h)         X(0xAD, 0, "res 5, l", res_5_l) \
+        X(0xAE, 0, "res 5, (hl)", res_5_mem_hl) X(0xAF, 0, "res 5, a", res_5_a) \
+                                                                                \
+        X(0xB0, 0, "res 6, b", res_6_b)         X(0xB1, 0, "res 6, c", res_6_c) \
+        X(0xB2, 0, "res 6, d", res_6_d)         X(0xB3, 0, "res 6, e", res_6_e) \
+        X(0xB4, 0, "res 6, h", res_6_h)         X(0xB5, 0, "res 6, l", res_6_l) \
+        X(0xB6, 0, "res 6, (hl)", res_6_mem_hl) X(0xB7, 0, "res 6, a", res_6_a) \
+        X(0xB8, 0, "res 7, b", res_7_b)         X(0xB9, 0, "res 7, c", res_7_c) \
+        X(0xBA, 0, "res 7, d", res_7_d)         X(0xBB, 0, "res 7, e", res_7_e) \
+        X(0xBC, 0, "res 7, h", res_7_h)         X(0xBD, 0, "res 7, l", res_7_l) \
+        X(0xBE, 0, "res 7, (hl)", res_7_mem_hl) X(0xBF, 0, "res 7, a", res_7_a) \
+                                                                                \
+        X(0xC0, 0, "set 0, b", set_0_b)         X(0xC1, 0, "set 0, c", set_0_c) \
+        X(0xC2, 0, "set 0, d", set_0_d)         X(0xC3, 0, "set 0, e", set_0_e) \
+        X(0xC4, 0, "set 0, h", set_0_h)         X(0xC5, 0, "set 0, l", set_0_l) \
+        X(0xC6, 0, "set 0, (hl)", set_0_mem_hl) X(0xC7, 0, "set 0, a", set_0_a) \
+        X(0xC8, 0, "set 1, b", set_1_b)         X(0xC9, 0, "set 1, c", set_1_c) \
+        X(0xCA, 0, "set 1, d", set_1_d)         X(0xCB, 0, "set 1, e", set_1_e) \
+        X(0xCC, 0, "set 1, h", set_1_h)         X(0xCD, 0, "set 1, l", set_1_l) \
+        X(0xCE, 0, "set 1, (hl)", set_1_mem_hl) X(0xCF, 0, "set 1, a", set_1_a) \
+                                                                                \
+        X(0xD0, 0, "set 2, b", set_2_b)         X(0xD1, 0, "set 2, c", set_2_c) \
+        X(0xD2, 0, "set 2, d", set_2_d)         X(0xD3, 0, "set 2, e", set_2_e) \
+        X(0xD4, 0, "set 2, h", set_2_h)         X(0xD5, 0, "set 2, l", set_2_l) \
+        X(0xD6, 0, "set 2, (hl)", set_2_mem_hl) X(0xD7, 0, "set 2, a", set_2_a) \
+        X(0xD8, 0, "set 3, b", set_3_b)         X(0xD9, 0, "set 3, c", set_3_c) \
+        X(0xDA, 0, "set 3, d", set_3_d)         X(0xDB, 0, "set 3, e", set_3_e) \
+        X(0xDC, 0, "set 3, h", set_3_h)         X(0xDD, 0, "set 3, l", set_3_l) \
+        X(0xDE, 0, "set 3, (hl)", set_3_mem_hl) X(0xDF, 0, "set 3, a", set_3_a) \
+                                                                                \
+        X(0xE0, 0, "set 4, b", set_4_b)         X(0xE1, 0, "set 4, c", set_4_c) \
+        X(0xE2, 0, "set 4, d", set_4_d)         X(0xE3, 0, "set 4, e", set_4_e) \
+        X(0xE4, 0, "set 4, h", set_4_h)         X(0xE5, 0, "set 4, l", set_4_l) \
+        X(0xE6, 0, "set 4, (hl)", set_4_mem_hl) X(0xE7, 0, "set 4, a", set_4_a) \
+        X(0xE8, 0, "set 5, b", set_5_b)         X(0xE9, 0, "set 5, c", set_5_c) \
+        X(0xEA, 0, "set 5, d", set_5_d)         X(0xEB, 0, "set 5, e", set_5_e) \
+        X(0xEC, 0, "set 5, h", set_5_h)         X(0xED, 0, "set 5, l", set_5_l) \
+        X(0xEE, 0, "set 5, (hl)", set_5_mem_hl) X(0xEF, 0, "set 5, a", set_5_a) \
+                                                                                \
+        X(0xF0, 0, "set 6, b", set_6_b)         X(0xF1, 0, "set 6, c", set_6_c) \
+        X(0xF2, 0, "set 6, d", set_6_d)         X(0xF3, 0, "set 6, e", set_6_e) \
+        X(0xF4, 0, "set 6, h", set_6_h)         X(0xF5, 0, "set 6, l", set_6_l) \
+        X(0xF6, 0, "set 6, (hl)", set_6_mem_hl) X(0xF7, 0, "set 6, a", set_6_a) \
+        X(0xF8, 0, "set 7, b", set_7_b)         X(0xF9, 0, "set 7, c", set_7_c) \
+        X(0xFA, 0, "set 7, d", set_7_d)         X(0xFB, 0, "set 7, e", set_7_e) \
+        X(0xFC, 0, "set 7, h", set_7_h)         X(0xFD, 0, "set 7, l", set_7_l) \
+        X(0xFE, 0, "set 7, (hl)", set_7_mem_hl) X(0xFF, 0, "set 7, a", set_7_a)
+
+/**
+ * PREFIX marks the CB prefix, which the block decoder resolves straight to the CB instruction
+ */
+#define OPCODES(X, PREFIX) \
+        X(0x00, 0, "nop", nop)                     X(0x01, 2, "ld bc, %.4X", ld_bc_u16)  \
+        X(0x02, 0, "ld (bc), a", ld_mem_bc_a)      X(0x03, 0, "inc bc", inc_bc)          \
+        X(0x04, 0, "inc b", inc_b)                 X(0x05, 0, "dec b", dec_b)            \
+        X(0x06, 1, "ld b, %.2X", ld_b_u8)          X(0x07, 0, "rlca", rlca)              \
+        X(0x08, 2, "ld (%.4X), sp", ld_mem_u16_sp) X(0x09, 0, "add hl, bc", add_hl_bc)   \
+        X(0x0A, 0, "ld a, (bc)", ld_a_mem_bc)      X(0x0B, 0, "dec bc", dec_bc)          \
+        X(0x0C, 0, "inc c", inc_c)                 X(0x0D, 0, "dec c", dec_c)            \
+        X(0x0E, 1, "ld c, %.2X", ld_c_u8)          X(0x0F, 0, "rrca", rrca)              \
+                                                                                         \
+        X(0x10, 1, "stop %.2X", stop)              X(0x11, 2, "ld de, %.4X", ld_de_u16)  \
+        X(0x12, 0, "ld (de), a", ld_mem_de_a)      X(0x13, 0, "inc de", inc_de)          \
+        X(0x14, 0, "inc d", inc_d)                 X(0x15, 0, "dec d", dec_d)            \
+        X(0x16, 1, "ld d, %.2X", ld_d_u8)          X(0x17, 0, "rla", rla)                \
+        X(0x18, 1, "jr %.2X", jr_s8)               X(0x19, 0, "add hl, de", add_hl_de)   \
+        X(0x1A, 0, "ld a, (de)", ld_a_mem_de)      X(0x1B, 0, "dec de", dec_de)          \
+        X(0x1C, 0, "inc e", inc_e)                 X(0x1D, 0, "dec e", dec_e)            \
+        X(0x1E, 1, "ld e, %.2X", ld_e_u8)          X(0x1F, 0, "rra", rra)                \
+                                                                                         \
+        X(0x20, 1, "jr nz, %.2X", jr_nz_s8)        X(0x21, 2, "ld hl, %.4X", ld_hl_u16)  \
+        X(0x22, 0, "ld (hl+), a", ldi_hl_a)        X(0x23, 0, "inc hl", inc_hl)          \
+        X(0x24, 0, "inc h", inc_h)                 X(0x25, 0, "dec h", dec_h)            \
+        X(0x26, 1, "ld h, %.2X", ld_h_u8)          X(0x27, 0, "daa", daa)                \
+        X(0x28, 1, "jr z, %.2X", jr_z_s8)          X(0x29, 0, "add hl, hl", add_hl_hl)   \
+        X(0x2A, 0, "ld a, (hl+)", ldi_a_hl)        X(0x2B, 0, "dec hl", dec_hl)          \
+        X(0x2C, 0, "inc l", inc_l)                 X(0x2D, 0, "dec l", dec_l)            \
+        X(0x2E, 1, "ld l, %.2X", ld_l_u8)          X(0x2F, 0, "cpl", cpl)                \
+                                                                                         \
+        X(0x30, 1, "jr nc, %.2X", jr_nc_s8)        X(0x31, 2, "ld sp, %.4X", ld_sp_u16)  \
+        X(0x32, 0, "ld (hl-), a", ldd_hl_a)        X(0x33, 0, "inc sp", inc_sp)          \
+        X(0x34, 0, "inc (hl)", inc_mem_hl)         X(0x35, 0, "dec (hl)", dec_mem_hl)    \
+        X(0x36, 1, "ld (hl), %.2X", ld_mem_hl_u8)  X(0x37, 0, "scf", scf)                \
+        X(0x38, 1, "jr c, %.2X", jr_c_s8)          X(0x39, 0, "add hl, sp", add_hl_sp)   \
+        X(0x3A, 0, "ld a, (hl-)", ldd_a_hl)        X(0x3B, 0, "dec sp", dec_sp)          \
+        X(0x3C, 0, "inc a", inc_a)                 X(0x3D, 0, "dec a", dec_a)            \
+        X(0x3E, 1, "ld a, %.2X", ld_a_u8)          X(0x3F, 0, "ccf", ccf)                \
+                                                                                         \
+        X(0x40, 0, "ld b, b", ld_b_b)              X(0x41, 0, "ld b, c", ld_b_c)         \
+        X(0x42, 0, "ld b, d", ld_b_d)              X(0x43, 0, "ld b, e", ld_b_e)         \
+        X(0x44, 0, "ld b, h", ld_b_h)              X(0x45, 0, "ld b, l", ld_b_l)         \
+        X(0x46, 0, "ld b, (hl)", ld_b_mem_hl)      X(0x47, 0, "ld b, a", ld_b_a)         \
+        X(0x48, 0, "ld c, b", ld_c_b)              X(0x49, 0, "ld c, c", ld_c_c)         \
+        X(0x4A, 0, "ld c, d", ld_c_d)              X(0x4B, 0, "ld c, e", ld_c_e)         \
+        X(0x4C, 0, "ld c, h", ld_c_h)              X(0x4D, 0, "ld c, l", ld_c_l)         \
+        X(0x4E, 0, "ld c, (hl)", ld_c_mem_hl)      X(0x4F, 0, "ld c, a", ld_c_a)         \
+                                                                                         \
+        X(0x50, 0, "ld d, b", ld_d_b)              X(0x51, 0, "ld d, c", ld_d_c)         \
+        X(0x52, 0, "ld d, d", ld_d_d)              X(0x53, 0, "ld d, e", ld_d_e)         \
+        X(0x54, 0, "ld d, h", ld_d_h)              X(0x55, 0, "ld d, l", ld_d_l)         \
+        X(0x56, 0, "ld d, (hl)", ld_d_mem_hl)      X(0x57, 0, "ld d, a", ld_d_a)         \
+        X(0x58, 0, "ld e, b", ld_e_b)              X(0x59, 0, "ld e, c", ld_e_c)         \
+        X(0x5A, 0, "ld e, d", ld_e_d)              X(0x5B, 0, "ld e, e", ld_e_e)         \
+        X(0x5C, 0, "ld e, h", ld_e_h)              X(0x5D, 0, "ld e, l", ld_e_l)         \
+        X(0x5E, 0, "ld e, (hl)", ld_e_mem_hl)      X(0x5F, 0, "ld e, a", ld_e_a)         \
+                                                                                         \
+        X(0x60, 0, "ld h, b", ld_h_b)              X(0x61, 0, "ld h, c", ld_h_c)         \
+        X(0x62, 0, "ld h, d", ld_h_d)              X(0x63, 0, "ld h, e", ld_h_e)         \
+        X(0x64, 0, "ld h, h", ld_h_h)              X(0x65, 0, "ld h, l", ld_h_l)         \
+        X(0x66, 0, "ld h, (hl)", ld_h_mem_hl)      X(0x67, 0, "ld h, a", ld_h_a)         \
+        X(0x68, 0, "ld l, b", ld_l_b)              X(0x69, 0, "ld l, c", ld_l_c)         \
+        X(0x6A, 0, "ld l, d", ld_l_d)              X(0x6B, 0, "ld l, e", ld_l_e)         \
+        X(0x6C, 0, "ld l, h", ld_l_h)              X(0x6D, 0, "ld l, l", ld_l_l)         \
+        X(0x6E, 0, "ld l, (hl)", ld_l_mem_hl)      X(0x6F, 0, "ld l, a", ld_l_a)         \
+                                                                                         \
+        X(0x70, 0, "ld (hl), b", ld_mem_hl_b)      X(0x71, 0, "ld (hl), c", ld_mem_hl_c) \
+        X(0x72, 0, "ld (hl), d", ld_mem_hl_d)      X(0x73, 0, "ld (hl), e", ld_mem_hl_e) \
+        X(0x74, 0, "ld (hl), h", ld_mem_hl_h)      X(0x75, 0, "ld (hl), l", ld_mem_hl_l) \
+        X(0x76, 0, "halt", halt)                   X(0x77, 0, "ld (hl), a", ld_mem_hl_a) \
+        X(0x78, 0, "ld a, b", ld_a_b)              X(0x79, 0, "ld a, c", ld_a_c)         \
+        X(0x7A, 0, "ld a, d", ld_a_d)              X(0x7B, 0, "ld a, e", ld_a_e)         \
+        X(0x7C, 0, "ld a, h", ld_a_h)              X(0x7D, 0, "ld a, l", ld_a_l)         \
+        X(0x7E, 0, "ld a, (hl)", ld_a_mem_hl)      X(0x7F, 0, "ld a, a", ld_a_a)         \
+                                                                                         \
+        X(0x80, 0, "add b", add_b)                 X(0x81, 0, "add c", add_c)            \
+        X(0x82, 0, "add d", add_d)                 X(0x83, 0, "add e", add_e)            \
+        X(0x84, 0, "add h", add_h)                 X(0x85, 0, "add l", add_l)            \
+        X(0x86, 0, "add (hl)", add_mem_hl)         X(0x87, 0, "add a", add_a)            \
+        X(0x88, 0, "adc b", adc_b)                 X(0x89, 0, "adc c", adc_c)            \
+        X(0x8A, 0, "adc d", adc_d)                 X(0x8B, 0, "adc e", adc_e)            \
+        X(0x8C, 0, "adc h", adc_h)                 X(0x8D, 0, "adc l", adc_l)            \
+        X(0x8E, 0, "adc (hl)", adc_mem_hl)         X(0x8F, 0, "adc a", adc_a)            \
+                                                                                         \
+        X(0x90, 0, "sub b", sub_b)                 X(0x91, 0, "sub c", sub_c)            \
+        X(0x92, 0, "sub d", sub_d)                 X(0x93, 0, "sub e", sub_e)            \
+        X(0x94, 0, "sub h", sub_h)                 X(0x95, 0, "sub l", sub_l)            \
+        X(0x96, 0, "sub (hl)", sub_mem_hl)         X(0x97, 0, "sub a", sub_a)            \
+        X(0x98, 0, "sbc b", sbc_b)                 X(0x99, 0, "sbc c", sbc_c)            \
+        X(0x9A, 0, "sbc d", sbc_d)                 X(0x9B, 0, "sbc e", sbc_e)            \
+        X(0x9C, 0, "sbc h", sbc_h)                 X(0x9D, 0, "sbc l", sbc_l)            \
+        X(0x9E, 0, "sbc (hl)", sbc_mem_hl)         X(0x9F, 0, "sbc a", sbc_a)            \
+                                                                                         \
+        X(0xA0, 0, "and b", and_b)                 X(0xA1, 0, "and c", and_c)            \
+        X(0xA2, 0, "and d", and_d)                 X(0xA3, 0, "and e", and_e)            \
+        X(0xA4, 0, "and h", and_h)                 X(0xA5, 0, "and l", and_l)            \
+        X(0xA6, 0, "and (hl)", and_mem_hl)         X(0xA7, 0, "and a", and_a)            \
+        X(0xA8, 0, "xor b", xor_b)                 X(0xA9, 0, "xor c", xor_c)            \
+        X(0xAA, 0, "xor d", xor_d)                 X(0xAB, 0, "xor e", xor_e)            \
+        X(0xAC, 0, "xor h", xor_h)                 X(0xAD, 0, "xor l", xor_l)            \
+        X(0xAE, 0, "xor (hl)", xor_mem_hl)         X(0xAF, 0, "xor a", xor_a)            \
+                                                                                         \
+        X(0xB0, 0, "or b", or_b)                   X(0xB1, 0, "or c", or_c)              \
+        X(0xB2, 0, "or d", or_d)                   X(0xB3, 0, "or e", or_e)              \
+        X(0xB4, 0, "or h", or_h)                   X(0xB5, 0, "or l", or_l)              \
+        X(0xB6, 0, "or (hl)", or_mem_hl)           X(0xB7, 0, "or a", or_a)              \
+        X(0xB8, 0, "cp b", cp_b)                   X(0xB9, 0, "cp c", cp_c)              \
+        X(0xBA, 0, "cp d", cp_d)                   X(0xBB, 0, "cp e", cp_e)              \
+        X(0xBC, 0, "cp h", cp_h)                   X(0xBD, 0, "cp l", cp_l)              \
+        X(0xBE, 0, "cp (hl)", cp_mem_hl)           X(0xBF, 0, "cp a", cp_a)              \
+                                                                                         \
+        X(0xC0, 0, "ret nz", ret_nz)               X(0xC1, 0, "pop bc", pop_bc)          \
+        X(0xC2, 2, "jp nz, %.4X", jp_nz_u16)       X(0xC3, 2, "jp %.4X", jp_u16)         \
+        X(0xC4, 2, "call nz, %.4X", call_nz_u16)   X(0xC5, 0, "push bc", push_bc)        \
+        X(0xC6, 1, "add %.2X", add_u8)             X(0xC7, 0, "rst 00", rst_00)          \
+        X(0xC8, 0, "ret z", ret_z)                 X(0xC9, 0, "ret", ret)                \
+        X(0xCA, 2, "jp z, %.4X", jp_z_u16)         PREFIX(0xCB, 1, "cb %.2X", cb)        \
+        X(0xCC, 2, "call z, %.4X", call_z_u16)     X(0xCD, 2, "call %.4X", call_u16)     \
+        X(0xCE, 1, "adc %.2X", adc_u8)             X(0xCF, 0, "rst 08", rst_08)          \
+                                                                                         \
+        X(0xD0, 0, "ret nc", ret_nc)               X(0xD1, 0, "pop de", pop_de)          \
+        X(0xD2, 2, "jp nc, %.4X", jp_nc_u16)       X(0xD3, 0, "invalid", nop)            \
+        X(0xD4, 2, "call nc, %.4X", call_nc_u16)   X(0xD5, 0, "push de", push_de)        \
+        X(0xD6, 1, "sub %.2X", sub_u8)             X(0xD7, 0, "rst 10", rst_10)          \
+        X(0xD8, 0, "ret c", ret_c)                 X(0xD9, 0, "reti", reti)              \
+        X(0xDA, 2, "jp c, %.4X", jp_c_u16)         X(0xDB, 0, "invalid", nop)            \
+        X(0xDC, 2, "call c, %.4X", call_c_u16)     X(0xDD, 0, "invalid", nop)            \
+        X(0xDE, 1, "sbc %.2X", sbc_u8)             X(0xDF, 0, "rst 18", rst_18)          \
+                                                                                         \
+        X(0xE0, 1, "ldh (%.2X), a", ldh_mem_u8_a)  X(0xE1, 0, "pop hl", pop_hl)          \
+        X(0xE2, 0, "ldh (c), a", ldh_mem_c_a)      X(0xE3, 0, "invalid", nop)            \
+        X(0xE4, 0, "invalid", nop)                 X(0xE5, 0, "push hl", push_hl)        \
+        X(0xE6, 1, "and %.2X", and_u8)             X(0xE7, 0, "rst 20", rst_20)          \
+        X(0xE8, 1, "add sp, %.2X", add_sp_s8)      X(0xE9, 0, "jp hl", jp_hl)            \
+        X(0xEA, 2, "ld (%.4X), a", ld_mem_u16_a)   X(0xEB, 0, "invalid", nop)            \
+        X(0xEC, 0, "invalid", nop)                 X(0xED, 0, "invalid", nop)            \
+        X(0xEE, 1, "xor %.2X", xor_u8)             X(0xEF, 0, "rst 28", rst_28)          \
+                                                                                         \
+        X(0xF0, 1, "ldh a, (%.2X)", ldh_a_mem_u8)  X(0xF1, 0, "pop af", pop_af)          \
+        X(0xF2, 0, "ldh a, (c)", ldh_a_mem_c)      X(0xF3, 0, "di", di)                  \
+        X(0xF4, 0, "invalid", nop)                 X(0xF5, 0, "push af", push_af)        \
+        X(0xF6, 1, "or %.2X", or_u8)               X(0xF7, 0, "rst 30", rst_30)          \
+        X(0xF8, 1, "ld hl, sp+%.2X", ld_hl_sp_s8)  X(0xF9, 0, "ld sp, hl", ld_sp_hl)     \
+        X(0xFA, 2, "ld a, (%.4X)", ld_a_mem_u16)   X(0xFB, 0, "ei", ei)                  \
+        X(0xFC, 0, "invalid", nop)                 X(0xFD, 0, "invalid", nop)            \
+        X(0xFE, 1, "cp %.2X", cp_u8)               X(0xFF, 0, "rst 38", rst_38)
+
+/**
+ * Superinstructions: sequences that dominate copy and poll loops, dispatched by the interpreter as
+ * one unit. Only the last op of a sequence may branch.
+ *
+ * PAIR(first, first_handler, second, second_handler)
+ * TRIPLE(first, first_handler, second, second_handler, third, third_handler)
+ */
+#define FUSED_OPCODES(PAIR, TRIPLE) \
+        TRIPLE(0xF0, ldh_a_mem_u8, 0xFE, cp_u8, 0x20, jr_nz_s8)        /* wait for ly */     \
+        TRIPLE(0xF0, ldh_a_mem_u8, 0xFE, cp_u8, 0x28, jr_z_s8)                               \
+        TRIPLE(0xF0, ldh_a_mem_u8, 0xE6, and_u8, 0x20, jr_nz_s8)       /* wait for stat */   \
+        TRIPLE(0xF0, ldh_a_mem_u8, 0xE6, and_u8, 0x28, jr_z_s8)                              \
+        TRIPLE(0x32, ldd_hl_a, 0x17C, bit_7_h, 0x20, jr_nz_s8)         /* clear vram */      \
+        PAIR(0x05, dec_b, 0x20, jr_nz_s8)                               /* counted loops */   \
+        PAIR(0x0D, dec_c, 0x20, jr_nz_s8)                                                    \
+        PAIR(0x15, dec_d, 0x20, jr_nz_s8)                                                    \
+        PAIR(0x1D, dec_e, 0x20, jr_nz_s8)                                                    \
+        PAIR(0x3D, dec_a, 0x20, jr_nz_s8)                                                    \
+        PAIR(0x2A, ldi_a_hl, 0x12, ld_mem_de_a)                         /* copy loops */      \
+        PAIR(0xF5, push_af, 0xC5, push_bc)                              /* save registers */  \
+        PAIR(0xC5, push_bc, 0xD5, push_de)                                                   \
+        PAIR(0xD5, push_de, 0xE5, push_hl)                                                   \
+        PAIR(0xE1, pop_hl, 0xD1, pop_de)                                /* restore them */    \
+        PAIR(0xD1, pop_de, 0xC1, pop_bc)                                                     \
+        PAIR(0xC1, pop_bc, 0xF1, pop_af)
+
+typedef enum GB15OpEffects {
+    /**
+     * May leave pc somewhere other than the following instruction
+     */
+    GB15_OP_BRANCHES = 0x01,
+
+    /**
+     * May write memory or enable interrupts, so code pages and pending interrupts must be rechecked
+     */
+    GB15_OP_WRITES = 0x02,
+
+} GB15OpEffects;
+
+/**
+ * Unconditional control flow and instructions that stop the CPU. The bytes after them are not
+ * necessarily code.
+ */
+static inline bool gb15_op_ends_block(u16 index) {
+    switch (index) {
+        case 0x10: // stop
+        case 0x18: // jr
+        case 0x76: // halt
+        case 0xC3: // jp
+        case 0xC9: // ret
+        case 0xD9: // reti
+        case 0xE9: // jp hl
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: // rst
+        case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * GB15OpEffects of a block op index. CB-prefixed instructions are 0x100-0x1FF.
+ */
+static inline u8 gb15_op_effects(u16 index) {
+    if (index > (u16)0xFF) { // every CB (hl) op but bit writes back
+        u8 opcode = (u8)index;
+        return (opcode & (u8)0x07) == (u8)0x06 && (opcode < (u8)0x40 || opcode >= (u8)0x80)? GB15_OP_WRITES : 0;
+    }
+    switch (index) {
+        case 0x20: case 0x28: case 0x30: case 0x38: // jr cc
+        case 0xC2: case 0xCA: case 0xD2: case 0xDA: // jp cc
+        case 0xC0: case 0xC8: case 0xD0: case 0xD8: // ret cc
+        case 0x18: case 0xC3: case 0xC9: case 0xE9: // jr, jp, ret, jp hl
+            return GB15_OP_BRANCHES;
+        case 0xC4: case 0xCC: case 0xD4: case 0xDC: // call cc
+        case 0xCD: case 0xD9: // call, reti
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: // rst
+        case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            return GB15_OP_BRANCHES | GB15_OP_WRITES;
+        case 0x02: case 0x12: case 0x22: case 0x32: // ld (rr), a
+        case 0x34: case 0x35: case 0x36: // inc (hl), dec (hl), ld (hl), u8
+        case 0x70: case 0x71: case 0x72: case 0x73: // ld (hl), r
+        case 0x74: case 0x75: case 0x77:
+        case 0x08: case 0xEA: case 0xE0: case 0xE2: // ld (u16), sp, ld (u16), a, ldh
+        case 0xC5: case 0xD5: case 0xE5: case 0xF5: // push
+        case 0xFB: // ei
+            return GB15_OP_WRITES;
+        default:
+            return 0;
+    }
+}
+
+#endif /* _GB15_OPCODES_H_ */
@@ -0,0 +1,134 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+/**
+ * AVX2 kernels are built for every x86 host and picked at run time when the CPU has it
+ */
+#define PIXELS_AVX2
+#endif
+
+#include "pixels.h"
+
+#ifndef GB15_DMG_ONLY
+#define RGB5(c) ((u32)(((c) << 3) | ((c) >> 2)))
+#define RGB555(v) (RGB5((v) & 0x1F) << 24 | RGB5(((v) >> 5) & 0x1F) << 16 | RGB5(((v) >> 10) & 0x1F) << 8 | (u32)0xFF)
+#define RGB555_4(v) RGB555(v), RGB555((v) + 1), RGB555((v) + 2), RGB555((v) + 3)
+#define RGB555_16(v) RGB555_4(v), RGB555_4((v) + 4), RGB555_4((v) + 8), RGB555_4((v) + 12)
+#define RGB555_64(v) RGB555_16(v), RGB555_16((v) + 16), RGB555_16((v) + 32), RGB555_16((v) + 48)
+#define RGB555_256(v) RGB555_64(v), RGB555_64((v) + 64), RGB555_64((v) + 128), RGB555_64((v) + 192)
+#define RGB555_1024(v) RGB555_256(v), RGB555_256((v) + 256), RGB555_256((v) + 512), RGB555_256((v) + 768)
+#define RGB555_4096(v) RGB555_1024(v), RGB555_1024((v) + 1024), RGB555_1024((v) + 2048), RGB555_1024((v) + 3072)
+
+/**
+ * Expanded by the preprocessor, so the table is built by the compiler and shared read-only by every
+ * state
+ */
+const u32 GB15_RGB555[32768] = {
+        RGB555_4096(0), RGB555_4096(4096), RGB555_4096(8192), RGB555_4096(12288),
+        RGB555_4096(16384), RGB555_4096(20480), RGB555_4096(24576), RGB555_4096(28672)
+};
+#endif
+
+#ifdef __SSE2__
+/**
+ * Decode the whole tile, two rows per vector. Each plane byte is spread across the 8 bytes of its
+ * row, then every byte is tested against the bit of its pixel.
+ */
+static void decode_tile_sse2(u8 *out, const u8 *pattern) {
+    const __m128i bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)0x80, 1, 2, 4, 8, 16, 32, 64, (char)0x80);
+    __m128i planes = _mm_loadu_si128((const __m128i *)pattern);
+    __m128i split = _mm_packus_epi16(_mm_and_si128(planes, _mm_set1_epi16(0x00FF)), _mm_srli_epi16(planes, 8));
+    __m128i lows = _mm_unpacklo_epi8(split, split);
+    __m128i highs = _mm_unpackhi_epi8(split, split);
+    for (u8 half = 0; half < 2; half++) {
+        __m128i low4 = half? _mm_unpackhi_epi16(lows, lows) : _mm_unpacklo_epi16(lows, lows);
+        __m128i high4 = half? _mm_unpackhi_epi16(highs, highs) : _mm_unpacklo_epi16(highs, highs);
+        for (u8 pair = 0; pair < 2; pair++) {
+            __m128i low = pair? _mm_unpackhi_epi32(low4, low4) : _mm_unpacklo_epi32(low4, low4);
+            __m128i high = pair? _mm_unpackhi_epi32(high4, high4) : _mm_unpacklo_epi32(high4, high4);
+            low = _mm_cmpeq_epi8(_mm_and_si128(low, bits), bits);
+            high = _mm_cmpeq_epi8(_mm_and_si128(high, bits), bits);
+            // Set bits compare to -1, so the index is the negated sum
+            __m128i index = _mm_sub_epi8(_mm_setzero_si128(), _mm_add_epi8(low, _mm_add_epi8(high, high)));
+            _mm_storeu_si128((__m128i *)(out + (half * 4 + pair * 2) * 8), index);
+        }
+    }
+}
+
+/**
+ * SSE2 has no byte shuffle, so each color is selected by comparing indices, 4 pixels per vector
+ */
+static void map_sse2(u32 *out, const u8 *indices, const u32 *palette, u32 count) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i colors[4];
+    for (u8 i = 0; i < 4; i++) {
+        colors[i] = _mm_set1_epi32((int)palette[i]);
+    }
+    for (u32 i = 0; i < count; i += 8) {
+        __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(indices + i)), zero);
+        for (u8 half = 0; half < 2; half++) {
+            __m128i index = half? _mm_unpackhi_epi16(words, zero) : _mm_unpacklo_epi16(words, zero);
+            __m128i pixels = zero;
+            for (u8 color = 0; color < 4; color++) {
+                __m128i match = _mm_cmpeq_epi32(index, _mm_set1_epi32(color));
+                pixels = _mm_or_si128(pixels, _mm_and_si128(match, colors[color]));
+            }
+            _mm_storeu_si128((__m128i *)(out + i + half * 4), pixels);
+        }
+    }
+}
+#endif
+
+#ifdef PIXELS_AVX2
+/**
+ * The palette sits in the low half of a vector and each index picks a lane of it, 8 pixels at once.
+ * Indices never exceed 3, so the undefined high half is never read.
+ */
+__attribute__((target("avx2")))
+static void map_avx2(u32 *out, const u8 *indices, const u32 *palette, u32 count) {
+    __m256i colors = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)palette));
+    for (u32 i = 0; i < count; i += 8) {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(indices + i)));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permutevar8x32_epi32(colors, index));
+    }
+}
+#endif
+
+void gb15_pixels_decode_tile(u8 *out, const u8 *pattern, u8 rows) {
+#ifdef __SSE2__
+    decode_tile_sse2(out, pattern);
+#else
+    for (u8 row = 0; row < 8; row++) {
+        if ((rows & (u8)(1 << row)) == 0) {
+            continue;
+        }
+        u8 low = pattern[row * 2];
+        u8 high = pattern[row * 2 + 1];
+        for (u8 bit = 0; bit < 8; bit++) {
+            u8 shift = (u8)7 - bit;
+            out[row * 8 + bit] = (u8)((((high >> shift) & (u8)0x01) << 1) | ((low >> shift) & (u8)0x01));
+        }
+    }
+#endif
+}
+
+#ifndef __SSE2__
+static void map_scalar(u32 *out, const u8 *indices, const u32 *palette, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        out[i] = palette[indices[i]];
+    }
+}
+#endif
+
+GB15PixelsMap gb15_pixels_map_kernel(void) {
+#ifdef PIXELS_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return map_avx2;
+    }
+#endif
+#ifdef __SSE2__
+    return map_sse2;
+#else
+    return map_scalar;
+#endif
+}
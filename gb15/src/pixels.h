@@ -0,0 +1,30 @@
+#ifndef _GB15_PIXELS_H_
+#define _GB15_PIXELS_H_
+
+#include <gb15/types.h>
+
+#ifndef GB15_DMG_ONLY
+/**
+ * Every Gameboy Color RGB555 color in the framebuffer's RGBA8888, each channel scaled to 8 bits
+ */
+extern const u32 GB15_RGB555[32768];
+#endif
+
+/**
+ * Split the rows of a tile whose bits are set in rows from their interleaved bit planes, 2 bytes
+ * each, into 8 palette indices each, leftmost pixel first. Other rows of out may be written with
+ * their current value too.
+ */
+void gb15_pixels_decode_tile(u8 *out, const u8 *pattern, u8 rows);
+
+/**
+ * Look up count palette indices, a multiple of 8, in a palette of 4 colors
+ */
+typedef void (*GB15PixelsMap)(u32 *out, const u8 *indices, const u32 *palette, u32 count);
+
+/**
+ * The fastest map kernel the host supports. Resolve it once and keep the pointer.
+ */
+GB15PixelsMap gb15_pixels_map_kernel(void);
+
+#endif /* _GB15_PIXELS_H_ */
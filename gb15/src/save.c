@@ -0,0 +1,86 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <gb15/gb15.h>
+
+bool gb15_save_open(GB15State *state, const char *path) {
+    gb15_save_close(state);
+    GB15Mmu *mmu = &state->mmu;
+    const GB15Cartridge *cartridge = state->cartridge;
+    if (cartridge == NULL || !cartridge->header.battery || cartridge->header.ram_size == 0) {
+        return false;
+    }
+    uz size = cartridge->header.ram_size;
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (info.st_size < (off_t)size && ftruncate(fd, (off_t)size) != 0)) {
+        close(fd);
+        return false;
+    }
+    void *ram = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ram == MAP_FAILED) {
+        return false;
+    }
+    state->save.ram = ram;
+    state->save.size = size;
+    gb15_mmu_map_cram(mmu, ram, true);
+    return true;
+}
+
+bool gb15_save_flush(GB15State *state) {
+    GB15Mmu *mmu = &state->mmu;
+    GB15Save *save = &state->save;
+    mmu->save_due = false;
+    if (save->ram == NULL) {
+        return true;
+    }
+
+    // msync works on whole host pages, so neighbouring dirty pages are coalesced into one call
+    uz host_page = (uz)sysconf(_SC_PAGESIZE);
+    uz pages = (save->size + 0xFF) >> 8;
+    uz start = 0;
+    uz end = 0;
+    bool ok = true;
+    for (uz index = 0; index < pages; index++) {
+        if (!mmu->cram_dirty[index]) {
+            continue;
+        }
+        uz from = (index << 8) & ~(host_page - 1);
+        uz to = (index + 1) << 8;
+        if (from > end) {
+            if (end != 0) {
+                ok &= msync(save->ram + start, end - start, MS_SYNC) == 0;
+            }
+            start = from;
+        }
+        end = to < save->size? to : save->size;
+    }
+    if (end != 0) {
+        ok &= msync(save->ram + start, end - start, MS_SYNC) == 0;
+    }
+    gb15_mmu_map_cram(mmu, save->ram, true);
+    return ok;
+}
+
+void gb15_save_close(GB15State *state) {
+    GB15Save *save = &state->save;
+    if (save->ram == NULL) {
+        return;
+    }
+    gb15_save_flush(state);
+    memcpy(state->mmu.cram_memory, save->ram, save->size);
+    gb15_mmu_map_cram(&state->mmu, state->mmu.cram_memory, false);
+    munmap(save->ram, save->size);
+    save->ram = NULL;
+    save->size = 0;
+}
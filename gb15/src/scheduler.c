@@ -0,0 +1,85 @@
+#include <gb15/scheduler.h>
+
+static inline void swap_events(GB15Event *a, GB15Event *b) {
+    GB15Event tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static void sift_up(GB15Scheduler *scheduler, u32 idx) {
+    while (idx > 0) {
+        u32 parent = (idx - 1) >> 1;
+        if (scheduler->events[parent].when <= scheduler->events[idx].when) {
+            break;
+        }
+        swap_events(scheduler->events + parent, scheduler->events + idx);
+        idx = parent;
+    }
+}
+
+static void sift_down(GB15Scheduler *scheduler, u32 idx) {
+    while (true) {
+        u32 left = (idx << 1) + 1;
+        u32 right = left + 1;
+        u32 smallest = idx;
+        if (left < scheduler->count && scheduler->events[left].when < scheduler->events[smallest].when) {
+            smallest = left;
+        }
+        if (right < scheduler->count && scheduler->events[right].when < scheduler->events[smallest].when) {
+            smallest = right;
+        }
+        if (smallest == idx) {
+            break;
+        }
+        swap_events(scheduler->events + smallest, scheduler->events + idx);
+        idx = smallest;
+    }
+}
+
+static void remove_at(GB15Scheduler *scheduler, u32 idx) {
+    scheduler->count--;
+    if (idx != scheduler->count) {
+        scheduler->events[idx] = scheduler->events[scheduler->count];
+        sift_down(scheduler, idx);
+        sift_up(scheduler, idx);
+    }
+}
+
+static inline void update_next(GB15Scheduler *scheduler) {
+    scheduler->next = scheduler->count? scheduler->events[0].when : UINT64_MAX;
+}
+
+void gb15_scheduler_init(GB15Scheduler *scheduler) {
+    scheduler->cycles = 0;
+    scheduler->count = 0;
+    update_next(scheduler);
+}
+
+void gb15_scheduler_schedule(GB15Scheduler *scheduler, GB15EventType type, u64 when) {
+    gb15_scheduler_cancel(scheduler, type);
+    u32 idx = scheduler->count++;
+    scheduler->events[idx].when = when;
+    scheduler->events[idx].type = type;
+    sift_up(scheduler, idx);
+    update_next(scheduler);
+}
+
+void gb15_scheduler_cancel(GB15Scheduler *scheduler, GB15EventType type) {
+    for (u32 i = 0; i < scheduler->count; i++) {
+        if (scheduler->events[i].type == type) {
+            remove_at(scheduler, i);
+            update_next(scheduler);
+            return;
+        }
+    }
+}
+
+bool gb15_scheduler_pop(GB15Scheduler *scheduler, GB15Event *event) {
+    if (scheduler->next > scheduler->cycles) {
+        return false;
+    }
+    *event = scheduler->events[0];
+    remove_at(scheduler, 0);
+    update_next(scheduler);
+    return true;
+}
@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <gb15/trace.h>
+
+void gb15_trace_start(GB15Trace *trace, GB15TraceRecord *records, u32 capacity) {
+    trace->mask = records == NULL? 0 : capacity - 1;
+    __atomic_store_n(&trace->head, 0, __ATOMIC_RELEASE);
+    trace->records = records;
+}
+
+u32 gb15_trace_read(const GB15Trace *trace, GB15TraceRecord *out, u32 capacity) {
+    const GB15TraceRecord *records = trace->records;
+    if (records == NULL || capacity == 0) {
+        return 0;
+    }
+    u64 size = (u64)trace->mask + 1;
+    u64 end = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+    u64 start = end > size? end - size : 0;
+    if (end - start > capacity) {
+        start = end - capacity;
+    }
+    for (u64 i = start; i < end; i++) {
+        out[i - start] = records[i & trace->mask];
+    }
+
+    // While head was at n the writer was filling the slot of record n - size, so everything up to
+    // and including that one may have been overwritten during the copy
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    u64 after = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+    u64 valid = after + 1 > size? after + 1 - size : 0;
+    if (valid >= end) {
+        return 0;
+    }
+    if (valid > start) {
+        memmove(out, out + (valid - start), (uz)(end - valid) * sizeof(GB15TraceRecord));
+        start = valid;
+    }
+    return (u32)(end - start);
+}
+
+bool gb15_trace_dump(const GB15Trace *trace, FILE *file) {
+    u32 capacity = trace->records == NULL? 0 : trace->mask + 1;
+    GB15TraceRecord *records = malloc((uz)capacity * sizeof(GB15TraceRecord) + 1);
+    if (records == NULL) {
+        return false;
+    }
+    u32 count = gb15_trace_read(trace, records, capacity);
+    u32 record_size = sizeof(GB15TraceRecord);
+    bool ok = fwrite(GB15_TRACE_MAGIC, 1, 8, file) == 8 &&
+              fwrite(&record_size, sizeof(record_size), 1, file) == 1 &&
+              fwrite(&count, sizeof(count), 1, file) == 1 &&
+              fwrite(records, sizeof(GB15TraceRecord), count, file) == count;
+    free(records);
+    return ok;
+}
@@ -1,3 +1,7 @@
+#define _DEFAULT_SOURCE
+
+#include <sys/mman.h>
+
 #include "util.h"
 
 s8 signify8(u8 value) {
@@ -6,3 +10,14 @@ s8 signify8(u8 value) {
     }
     return -(s8)(((~value) + (u8)1) & (u8)0xFF);
 }
+
+void *gb15_pages_alloc(uz size) {
+    void *pages = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return pages == MAP_FAILED? NULL : pages;
+}
+
+void gb15_pages_free(void *pages, uz size) {
+    if (pages != NULL) {
+        munmap(pages, size);
+    }
+}
@@ -5,4 +5,11 @@
 
 s8 signify8(u8 value);
 
+/**
+ * Zeroed memory in a mapping of its own, so it starts on a page boundary and shares no cache lines
+ * with anything else. NULL when it cannot be mapped.
+ */
+void *gb15_pages_alloc(uz size);
+void gb15_pages_free(void *pages, uz size);
+
 #endif /* _GB15_UTIL_H_ */
\ No newline at end of file
@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gb15/types.h>
+
+#include "opcodes.h"
+
+/**
+ * Only the unbanked view of the cartridge is recompiled: bank 0 at 0x0000 and bank 1 at 0x4000
+ */
+#define ROM_LIMIT 0x8000
+
+#define MAX_BLOCK_OPS 256
+
+typedef struct OpInfo {
+    u8 num_operands;
+    const char *name;
+    const char *handler;
+} OpInfo;
+
+#define OP_INFO(opcode, operands, name, function) {operands, name, #function},
+
+static const OpInfo OPS[256] = {
+        OPCODES(OP_INFO, OP_INFO)
+};
+
+static const OpInfo CB_OPS[256] = {
+        CB_OPCODES(OP_INFO)
+};
+
+typedef struct Op {
+    u16 index;
+    u16 imm;
+    u16 pc;
+    u16 next;
+} Op;
+
+typedef struct Entry {
+    u16 pc;
+    u16 block;
+} Entry;
+
+static u8 rom[ROM_LIMIT];
+static bool leader[ROM_LIMIT];
+static bool seen[ROM_LIMIT];
+static u16 queue[ROM_LIMIT];
+static u32 queue_size;
+static Entry entries[ROM_LIMIT];
+static u32 num_entries;
+
+static const OpInfo *op_info(u16 index) {
+    return index > (u16)0xFF? CB_OPS + (index & (u16)0xFF) : OPS + index;
+}
+
+/**
+ * Decode the instruction at pc. Fails when it does not fit below the given limit.
+ */
+static bool decode(u16 pc, u32 limit, Op *op) {
+    u8 opcode = rom[pc];
+    u32 next = (u32)pc + 1 + OPS[opcode].num_operands;
+    if (next > limit) {
+        return false;
+    }
+    op->pc = pc;
+    op->next = (u16)next;
+    switch (OPS[opcode].num_operands) {
+        case 1:
+            op->imm = rom[pc + 1];
+            break;
+        case 2:
+            op->imm = (u16)rom[pc + 1] | ((u16)rom[pc + 2] << 8);
+            break;
+        default:
+            op->imm = 0;
+            break;
+    }
+    op->index = opcode == (u8)0xCB? (u16)0x100 | op->imm : (u16)opcode;
+    return true;
+}
+
+/**
+ * Destination of a direct jr, jp, call or rst
+ */
+static bool branch_target(const Op *op, u16 *target) {
+    switch (op->index) {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+            *target = op->imm < 0x80? (u16)(op->next + op->imm) : (u16)(op->next + op->imm - 0x100);
+            return true;
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+            *target = op->imm;
+            return true;
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF:
+        case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            *target = op->index & (u16)0x38;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void add_leader(u16 pc) {
+    if (pc < ROM_LIMIT && !leader[pc]) {
+        leader[pc] = true;
+        queue[queue_size++] = pc;
+    }
+}
+
+/**
+ * Blocks never cross from bank 0 into the switchable bank
+ */
+static u32 region_limit(u16 pc) {
+    return pc < 0x4000? 0x4000 : ROM_LIMIT;
+}
+
+static void walk(void) {
+    add_leader(0x0100);
+    for (u16 vector = 0x00; vector <= 0x60; vector += 0x08) {
+        add_leader(vector);
+    }
+    while (queue_size != 0) {
+        u16 pc = queue[--queue_size];
+        u32 limit = region_limit(pc);
+        Op op;
+        while (pc < limit && !seen[pc] && decode(pc, limit, &op)) {
+            seen[pc] = true;
+            u16 target;
+            if (branch_target(&op, &target)) {
+                add_leader(target);
+            }
+            if (op.index == 0x10 || op.index == 0x76) { // stop and halt resume at the next instruction
+                add_leader(op.next);
+            }
+            if (gb15_op_ends_block(op.index)) {
+                break;
+            }
+            pc = op.next;
+        }
+    }
+}
+
+static u32 decode_block(u16 start, Op *ops) {
+    u32 limit = region_limit(start);
+    u32 length = 0;
+    u16 pc = start;
+    while (length < MAX_BLOCK_OPS && pc < limit && (length == 0 || !leader[pc]) && decode(pc, limit, ops + length)) {
+        pc = ops[length].next;
+        if (gb15_op_ends_block(ops[length++].index)) {
+            break;
+        }
+    }
+    return length;
+}
+
+static void emit_block(FILE *out, u16 start) {
+    Op ops[MAX_BLOCK_OPS];
+    u32 length = decode_block(start, ops);
+    if (length == 0) { // runs off the end of its bank, left to the interpreter
+        fprintf(out, "static void block_%.4X(GB15State *state) {\n}\n\n", start);
+        return;
+    }
+
+    bool writes = false;
+    for (u32 i = 0; i < length; i++) {
+        writes |= (gb15_op_effects(ops[i].index) & GB15_OP_WRITES) != 0;
+        entries[num_entries].pc = ops[i].pc;
+        entries[num_entries].block = start;
+        num_entries++;
+    }
+
+    fprintf(out, "static void block_%.4X(GB15State *state) {\n", start);
+    fprintf(out, "    GB15Cpu *cpu = &state->cpu;\n");
+    fprintf(out, "    GB15Mmu *mmu = &state->mmu;\n");
+    fprintf(out, "    GB15Scheduler *scheduler = &state->scheduler;\n");
+    fprintf(out, "    switch (cpu->pc) {\n");
+    for (u32 i = 0; i < length; i++) {
+        fprintf(out, "        case 0x%.4X: goto op_%.4X;\n", ops[i].pc, ops[i].pc);
+    }
+    fprintf(out, "        default: return;\n");
+    fprintf(out, "    }\n");
+
+    for (u32 i = 0; i < length; i++) {
+        const Op *op = ops + i;
+        const OpInfo *info = op_info(op->index);
+        char name[32];
+        if (op->index > (u16)0xFF) {
+            snprintf(name, sizeof(name), "%s", info->name);
+        } else {
+            snprintf(name, sizeof(name), info->name, op->imm);
+        }
+        u8 effects = gb15_op_effects(op->index);
+        fprintf(out, "op_%.4X: // %s\n", op->pc, name);
+        fprintf(out, "    cpu->pc = 0x%.4X;\n", op->next);
+        fprintf(out, "    scheduler->cycles += %s(cpu, mmu, 0x%.4X);\n", info->handler, op->imm);
+        fprintf(out, "    if (scheduler->cycles >= scheduler->next) {\n");
+        fprintf(out, "        return;\n");
+        fprintf(out, "    }\n");
+        if (i + 1 == length) {
+            break;
+        }
+        if (effects & GB15_OP_BRANCHES) {
+            fprintf(out, "    if (cpu->pc != 0x%.4X) {\n", op->next);
+            fprintf(out, "        return;\n");
+            fprintf(out, "    }\n");
+        }
+        if (effects & GB15_OP_WRITES) {
+            fprintf(out, "    if (mmu->code_written || (cpu->ime && (mmu->io[GB15_IO_IF] & mmu->io[GB15_IO_IE]))) {\n");
+            fprintf(out, "        return;\n");
+            fprintf(out, "    }\n");
+        }
+    }
+
+    // Same rule as the JIT: without writes the banks, code and pending interrupts are unchanged,
+    // so a block that branches back to its start runs again straight away. Any other successor is
+    // reached by returning to the run loop, which looks it up; calling it from here would nest
+    // one C frame per block executed.
+    const Op *last = ops + length - 1;
+    u16 target;
+    if (!writes && branch_target(last, &target) && target == start) {
+        fprintf(out, "    if (cpu->pc == 0x%.4X) {\n", target);
+        fprintf(out, "        goto op_%.4X;\n", target);
+        fprintf(out, "    }\n");
+    }
+    fprintf(out, "}\n\n");
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const Entry *x = a;
+    const Entry *y = b;
+    if (x->pc != y->pc) {
+        return (int)x->pc - (int)y->pc;
+    }
+    // Prefer the block that starts at the entry
+    return (x->block != x->pc) - (y->block != y->pc);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s <rom> <output.c> <symbol>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+    memset(rom, 0xFF, sizeof(rom));
+    size_t size = fread(rom, 1, sizeof(rom), in);
+    fclose(in);
+    if (size < 0x150) {
+        fprintf(stderr, "%s is too small to be a cartridge\n", argv[1]);
+        return 1;
+    }
+
+    walk();
+
+    FILE *out = fopen(argv[2], "w");
+    if (out == NULL) {
+        fprintf(stderr, "Could not open %s\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "/*\n * Recompiled from %s by gb15rc. Do not edit.\n */\n", argv[1]);
+    fprintf(out, "#include \"handlers.h\"\n\n");
+    for (u32 pc = 0; pc < ROM_LIMIT; pc++) {
+        if (leader[pc]) {
+            emit_block(out, (u16)pc);
+        }
+    }
+
+    qsort(entries, num_entries, sizeof(Entry), compare_entries);
+    fprintf(out, "static const GB15RecompiledEntry ENTRIES[] = {\n");
+    u32 count = 0;
+    for (u32 i = 0; i < num_entries; i++) {
+        if (i != 0 && entries[i].pc == entries[i - 1].pc) {
+            continue;
+        }
+        fprintf(out, "        {0x%.4X, block_%.4X},\n", entries[i].pc, entries[i].block);
+        count++;
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "const GB15Recompiled %s = {0x%.2X%.2X, ENTRIES, %u};\n", argv[3], rom[0x014E], rom[0x014F], count);
+    fclose(out);
+
+    fprintf(stderr, "%s: %u instructions\n", argv[2], count);
+    return 0;
+}
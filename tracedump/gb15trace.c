@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <gb15/types.h>
+#include <gb15/trace.h>
+
+#include "opcodes.h"
+
+typedef struct OpInfo {
+    u8 num_operands;
+    const char *name;
+} OpInfo;
+
+#define OP_INFO(opcode, operands, name, function) {operands, name},
+
+static const OpInfo OPS[256] = {
+        OPCODES(OP_INFO, OP_INFO)
+};
+
+/**
+ * Print a record the way the interpreter's instruction log used to
+ */
+static void print_record(const GB15TraceRecord *record) {
+    const OpInfo *info = OPS + (record->index > (u16)0xFF? (u16)0xCB : record->index);
+    printf("af=%.4X|bc=%.4X|de=%.4X|hl=%.4X|pc=%.4X|sp=%.4X :: ",
+           record->af,
+           record->bc,
+           record->de,
+           record->hl,
+           record->pc,
+           record->sp
+    );
+    if (info->num_operands != 0) {
+        printf(info->name, record->imm);
+    } else {
+        printf(info->name);
+    }
+    printf("\n\tlcdc=%.2X|stat=%.2X|ly=%.2X|ie=%.2X|if=%.2X|*sp=%.2X%.2X\n",
+           record->lcdc,
+           record->stat,
+           record->ly,
+           record->ie,
+           record->iflag,
+           record->stack >> 8,
+           record->stack & 0xFF
+    );
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <dump>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    char magic[8];
+    u32 record_size;
+    u32 count;
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, GB15_TRACE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&record_size, sizeof(record_size), 1, in) != 1 || fread(&count, sizeof(count), 1, in) != 1) {
+        fprintf(stderr, "%s is not a trace dump\n", argv[1]);
+        fclose(in);
+        return 1;
+    }
+    if (record_size != sizeof(GB15TraceRecord)) {
+        fprintf(stderr, "%s has %u byte records, expected %u\n", argv[1], record_size, (u32)sizeof(GB15TraceRecord));
+        fclose(in);
+        return 1;
+    }
+
+    GB15TraceRecord record;
+    for (u32 i = 0; i < count; i++) {
+        if (fread(&record, sizeof(record), 1, in) != 1) {
+            fprintf(stderr, "%s is truncated after %u records\n", argv[1], i);
+            fclose(in);
+            return 1;
+        }
+        print_record(&record);
+    }
+    fclose(in);
+    return 0;
+}